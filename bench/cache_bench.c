@@ -0,0 +1,100 @@
+/*
+ * cache_bench.c - Cache hit rate benchmark.
+ *
+ * Compares the hit rate of lru_cache_t and tinylfu_cache_t on a
+ * skewed (Zipf) workload, with and without scans mixed in, and
+ * the cost of an operation.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../include/lru_cache.h"
+#include "../include/tinylfu_cache.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_KEYS (1 << 20)
+#define N_ACCESSES (1 << 22)
+#define CAPACITY (1 << 14)
+/* With scans, every SCAN_EVERY accesses, SCAN_LEN keys are accessed once */
+#define SCAN_EVERY 50000
+#define SCAN_LEN (2 * CAPACITY)
+
+static double now(void){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Generates the trace of keys. The popular keys are picked with a
+ * Zipf distribution (s = 1), by binary search on its cumulative function.
+ */
+static long* make_trace(int scans){
+        double *cdf = malloc(N_KEYS * sizeof(double));
+        double sum = 0;
+        for (long i = 0; i < N_KEYS; i++) {
+                sum += 1.0 / (i + 1);
+                cdf[i] = sum;
+        }
+        long *trace = malloc(N_ACCESSES * sizeof(long));
+        long scan_key = N_KEYS;
+        for (long i = 0; i < N_ACCESSES; i++) {
+                if (scans && i % SCAN_EVERY < SCAN_LEN) {
+                        trace[i] = scan_key++;
+                        continue;
+                }
+                double r = (double) rand() / RAND_MAX * sum;
+                long lo = 0, hi = N_KEYS - 1;
+                while (lo < hi) {
+                        long mid = (lo + hi) / 2;
+                        if (cdf[mid] < r)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                /* Scatter the popular keys */
+                trace[i] = (lo * 7919) % N_KEYS;
+        }
+        free(cdf);
+        return trace;
+}
+
+static void bench(const char *workload, const long *trace){
+        lru_cache_t *lru = lru_cache_init(sizeof(long), sizeof(long), hash_u64_mix, compare_long, CAPACITY);
+        double start = now();
+        for (long i = 0; i < N_ACCESSES; i++) {
+                if (!lru_cache_get_ref(lru, (void*) &trace[i]))
+                        lru_cache_put(lru, (void*) &trace[i], (void*) &trace[i]);
+        }
+        double lru_time = now() - start;
+        lru_cache_stats_t ls = lru_cache_stats(lru);
+
+        tinylfu_cache_t *tlfu = tinylfu_cache_init(sizeof(long), sizeof(long), hash_u64_mix, compare_long, CAPACITY);
+        start = now();
+        for (long i = 0; i < N_ACCESSES; i++) {
+                if (!tinylfu_cache_get_ref(tlfu, (void*) &trace[i]))
+                        tinylfu_cache_put(tlfu, (void*) &trace[i], (void*) &trace[i]);
+        }
+        double tlfu_time = now() - start;
+        tinylfu_cache_stats_t ts = tinylfu_cache_stats(tlfu);
+
+        printf("%-12s %-10s %8.2f%% %8.1f ns/access\n", workload, "lru",
+               100.0 * ls.hits / (ls.hits + ls.misses), lru_time * 1e9 / N_ACCESSES);
+        printf("%-12s %-10s %8.2f%% %8.1f ns/access\n", workload, "tinylfu",
+               100.0 * ts.hits / (ts.hits + ts.misses), tlfu_time * 1e9 / N_ACCESSES);
+        lru_cache_free(lru);
+        tinylfu_cache_free(tlfu);
+}
+
+int main(void){
+        printf("[cache bench: %d keys, %d accesses, capacity %d]\n", N_KEYS, N_ACCESSES, CAPACITY);
+        printf("%-12s %-10s %9s\n", "workload", "cache", "hit rate");
+        long *trace = make_trace(0);
+        bench("zipf", trace);
+        free(trace);
+        trace = make_trace(1);
+        bench("zipf+scans", trace);
+        free(trace);
+        return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * concurrent_hash_map_bench.c - Thread scaling benchmark.
+ *
+ * Compares a hash_map_t behind a single mutex with the
+ * sharded concurrent_hashmap_t, from 1 to 64 threads.
+ * Every thread does OPS operations: 90% gets and 10% puts
+ * over a key space of N_KEYS integers.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../include/concurrent_hash_map.h"
+#include "../include/hash_map.h"
+#include "hash.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_KEYS (1 << 16)
+#define OPS 200000
+#define MAX_THREADS 64
+
+/* hash_int is the identity, so spread the keys to avoid
+   measuring the clustering of consecutive integers */
+#define KEY(i) ((int) ((unsigned) (i) * 2654435761u))
+
+static hash_map_t *locked_map;
+static pthread_mutex_t map_lock = PTHREAD_MUTEX_INITIALIZER;
+static concurrent_hashmap_t *sharded_map;
+
+static double now(void){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* xorshift, so the threads don't share rand()'s state */
+static unsigned next_rand(unsigned *state){
+        unsigned x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return *state = x;
+}
+
+static void* run_locked(void *arg){
+        unsigned seed = (unsigned)(size_t) arg;
+        for (int i = 0; i < OPS; i++) {
+                unsigned r = next_rand(&seed);
+                int key = KEY(r % N_KEYS), value;
+                pthread_mutex_lock(&map_lock);
+                if (r % 10 == 0)
+                        hashmap_put(locked_map, &key, &key);
+                else
+                        hashmap_get(locked_map, &key, &value);
+                pthread_mutex_unlock(&map_lock);
+        }
+        return NULL;
+}
+
+static void* run_sharded(void *arg){
+        unsigned seed = (unsigned)(size_t) arg;
+        for (int i = 0; i < OPS; i++) {
+                unsigned r = next_rand(&seed);
+                int key = KEY(r % N_KEYS), value;
+                if (r % 10 == 0)
+                        concurrent_hashmap_put(sharded_map, &key, &key);
+                else
+                        concurrent_hashmap_get(sharded_map, &key, &value);
+        }
+        return NULL;
+}
+
+static double run(void* (*fn)(void*), int n_threads){
+        pthread_t threads[MAX_THREADS];
+        double start = now();
+        for (int i = 0; i < n_threads; i++)
+                pthread_create(&threads[i], NULL, fn, (void*)(size_t)(i * 7919 + 1));
+        for (int i = 0; i < n_threads; i++)
+                pthread_join(threads[i], NULL);
+        double elapsed = now() - start;
+        return n_threads * (double) OPS / elapsed / 1e6;
+}
+
+int main(void){
+        locked_map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        sharded_map = concurrent_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int, 0);
+        for (int i = 0; i < N_KEYS; i += 2) {
+                int key = KEY(i);
+                hashmap_put(locked_map, &key, &i);
+                concurrent_hashmap_put(sharded_map, &key, &i);
+        }
+
+        printf("[concurrent_hash_map bench: %d ops/thread, 90%% get, 10%% put]\n", OPS);
+        printf("%8s %16s %16s\n", "threads", "mutex (Mops/s)", "sharded (Mops/s)");
+        for (int n = 1; n <= MAX_THREADS; n *= 2)
+                printf("%8d %16.2f %16.2f\n", n, run(run_locked, n), run(run_sharded, n));
+
+        hashmap_free(locked_map);
+        concurrent_hashmap_free(sharded_map);
+        return 0;
+}
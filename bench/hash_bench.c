@@ -0,0 +1,90 @@
+/*
+ * hash_bench.c - Hash function benchmark.
+ *
+ * Measures the speed of the string hashes, and the effect of
+ * the integer hashes on the lookups of a hash_map with prime
+ * sizing and LINEAR_HASHING (the default configuration).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../include/hash.h"
+#include "../include/hash_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define N_STRINGS 4096
+#define STRING_ROUNDS 200
+/* Kept small: with hash_int, the misses scan a cluster as big as the table */
+#define N_KEYS (1 << 16)
+
+static double now(void){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_strings(size_t len){
+        char **strs = malloc(N_STRINGS * sizeof(char*));
+        for (int i = 0; i < N_STRINGS; i++) {
+                strs[i] = malloc(len + 1);
+                for (size_t j = 0; j < len; j++)
+                        strs[i][j] = 'a' + rand() % 26;
+                strs[i][len] = '\0';
+        }
+
+        hashcode_t sink = 0;
+        double start = now();
+        for (int r = 0; r < STRING_ROUNDS; r++)
+                for (int i = 0; i < N_STRINGS; i++)
+                        sink ^= hash_string(&strs[i]);
+        double djb2 = now() - start;
+
+        start = now();
+        for (int r = 0; r < STRING_ROUNDS; r++)
+                for (int i = 0; i < N_STRINGS; i++)
+                        sink ^= hash_string_fast(&strs[i]);
+        double fast = now() - start;
+
+        double n = (double) N_STRINGS * STRING_ROUNDS;
+        printf("%6zu %18.1f %18.1f   (%llx)\n", len, djb2 * 1e9 / n, fast * 1e9 / n, (unsigned long long) sink & 0xF);
+
+        for (int i = 0; i < N_STRINGS; i++)
+                free(strs[i]);
+        free(strs);
+}
+
+/*
+ * Puts N_KEYS consecutive integers, and then looks up
+ * the same number of keys, half of which are missing.
+ */
+static void bench_ints(const char *name, hash_function_t hash){
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash, compare_int);
+        double start = now();
+        for (int i = 0; i < N_KEYS; i++)
+                hashmap_put(map, &i, &i);
+        double put = now() - start;
+
+        start = now();
+        size_t hits = 0;
+        for (int i = 0; i < N_KEYS; i++) {
+                int key = (int) (((unsigned) i * 7919u) % (2 * N_KEYS));
+                hits += hashmap_exists(map, &key);
+        }
+        double get = now() - start;
+        printf("%-14s %12.1f %12.1f   (%zu hits)\n", name, put * 1e9 / N_KEYS, get * 1e9 / N_KEYS, hits);
+        hashmap_free(map);
+}
+
+int main(void){
+        printf("[hash bench: strings, ns/hash]\n");
+        printf("%6s %18s %18s\n", "length", "hash_string", "hash_string_fast");
+        for (size_t len = 4; len <= 256; len *= 4)
+                bench_strings(len);
+
+        printf("\n[hash bench: %d consecutive int keys, ns/op]\n", N_KEYS);
+        printf("%-14s %12s %12s\n", "hash", "put", "lookup");
+        bench_ints("hash_int", hash_int);
+        bench_ints("hash_u32_mix", hash_u32_mix);
+        return 0;
+}
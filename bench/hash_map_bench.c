@@ -0,0 +1,107 @@
+/*
+ * hash_map_bench.c - Lookup benchmark.
+ *
+ * Compares hashmap_get in a loop with hashmap_get_batch,
+ * on a table much bigger than the cache, and the cost of
+ * loading the table with hashmap_put, hashmap_from_arrays and
+ * hashmap_open_mmap. Also compares hashmap_get with the lookup
+ * of a map generated by GDS_DEFINE_HASHMAP.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../include/hash_map.h"
+#include "../include/typed_hash_map.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_KEYS (1 << 22)
+#define N_LOOKUPS (1 << 22)
+#define SNAPSHOT_PATH "hash_map_bench.snapshot"
+
+GDS_DEFINE_HASHMAP(longmap, long, long, gds_mix64(key), a == b)
+
+static double now(void){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_load(void){
+        long *keys = malloc(N_KEYS * sizeof(long));
+        for (long i = 0; i < N_KEYS; i++)
+                keys[i] = i;
+
+        double start = now();
+        hash_map_t *map = hashmap_init(sizeof(long), sizeof(long), hash_u64_mix, compare_long);
+        for (long i = 0; i < N_KEYS; i++)
+                hashmap_put(map, &keys[i], &keys[i]);
+        double put = now() - start;
+        hashmap_free(map);
+
+        start = now();
+        map = hashmap_from_arrays(keys, keys, N_KEYS, sizeof(long), sizeof(long), hash_u64_mix, compare_long);
+        double bulk = now() - start;
+        hashmap_save(map, SNAPSHOT_PATH);
+        hashmap_free(map);
+
+        start = now();
+        map = hashmap_open_mmap(SNAPSHOT_PATH, hash_u64_mix, compare_long);
+        double open = now() - start;
+        hashmap_free(map);
+        remove(SNAPSHOT_PATH);
+
+        printf("%-20s %8.1f ms\n", "hashmap_put loop", put * 1e3);
+        printf("%-20s %8.1f ms\n", "hashmap_from_arrays", bulk * 1e3);
+        printf("%-20s %8.3f ms\n", "hashmap_open_mmap", open * 1e3);
+        free(keys);
+}
+
+int main(void){
+        printf("[hash_map bench: loading %d keys]\n", N_KEYS);
+        bench_load();
+
+        hash_map_t *map = hashmap_init(sizeof(long), sizeof(long), hash_long, compare_long);
+        /* hash_long is the identity. Consecutive keys would make a single
+           cluster as big as the table with prime sizing. */
+        hashmap_set_sizing(map, POW2_SIZING);
+        for (long i = 0; i < N_KEYS; i++)
+                hashmap_put(map, &i, &i);
+
+        long *keys = malloc(N_LOOKUPS * sizeof(long));
+        long *dests = malloc(N_LOOKUPS * sizeof(long));
+        for (long i = 0; i < N_LOOKUPS; i++)
+                keys[i] = (long) (((unsigned long) rand() << 16 ^ rand()) % (2 * N_KEYS));
+
+        printf("[hash_map bench: %d keys, %d lookups, ~50%% hits]\n", N_KEYS, N_LOOKUPS);
+
+        double start = now();
+        size_t hits = 0;
+        for (long i = 0; i < N_LOOKUPS; i++)
+                hits += hashmap_get(map, &keys[i], &dests[i]) != NULL;
+        double loop = now() - start;
+
+        start = now();
+        size_t batch_hits = hashmap_get_batch(map, keys, N_LOOKUPS, dests, NULL);
+        double batch = now() - start;
+
+        printf("%-20s %8.1f ns/lookup (%zu hits)\n", "hashmap_get", loop * 1e9 / N_LOOKUPS, hits);
+        printf("%-20s %8.1f ns/lookup (%zu hits)\n", "hashmap_get_batch", batch * 1e9 / N_LOOKUPS, batch_hits);
+
+        longmap_t *typed = longmap_init();
+        longmap_reserve(typed, N_KEYS);
+        for (long i = 0; i < N_KEYS; i++)
+                longmap_put(typed, i, i);
+        start = now();
+        size_t typed_hits = 0;
+        for (long i = 0; i < N_LOOKUPS; i++)
+                typed_hits += longmap_get(typed, keys[i], &dests[i]) != NULL;
+        double typed_loop = now() - start;
+        printf("%-20s %8.1f ns/lookup (%zu hits)\n", "GDS_DEFINE_HASHMAP", typed_loop * 1e9 / N_LOOKUPS, typed_hits);
+        longmap_free(typed);
+
+        free(keys);
+        free(dests);
+        hashmap_free(map);
+        return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * typed_bench.c - Generic vs type-specialized containers.
+ *
+ * Compares vector_t and heap_t, which copy elements with memcpy and
+ * compare them through function pointers, with the containers
+ * generated by GDS_DEFINE_VECTOR and GDS_DEFINE_HEAP, on ints.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../include/vector.h"
+#include "../include/heap.h"
+#include "../include/typed_vector.h"
+#include "../include/typed_heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N_ELEMENTS (1 << 22)
+#define N_HEAP (1 << 20)
+
+GDS_DEFINE_VECTOR(intvec, int)
+GDS_DEFINE_HEAP(intheap, int, a < b)
+
+static double now(void){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_vector(void){
+        double start = now();
+        vector_t *v = vector_init(sizeof(int), compare_int);
+        for (int i = 0; i < N_ELEMENTS; i++)
+                vector_append(v, &i);
+        long sum = 0;
+        for (int i = 0; i < N_ELEMENTS; i++) {
+                int x;
+                sum += *(int*) vector_at(v, i, &x);
+        }
+        double generic = now() - start;
+        vector_free(v);
+
+        start = now();
+        intvec_t *tv = intvec_init();
+        for (int i = 0; i < N_ELEMENTS; i++)
+                intvec_append(tv, i);
+        long typed_sum = 0;
+        for (int i = 0; i < N_ELEMENTS; i++) {
+                int x;
+                typed_sum += *intvec_at(tv, i, &x);
+        }
+        double typed = now() - start;
+        intvec_free(tv);
+
+        printf("%-20s %8.2f ns/element (sum %ld)\n", "vector_t", generic * 1e9 / N_ELEMENTS, sum);
+        printf("%-20s %8.2f ns/element (sum %ld)\n", "GDS_DEFINE_VECTOR", typed * 1e9 / N_ELEMENTS, typed_sum);
+}
+
+static void bench_heap(void){
+        int *values = malloc(N_HEAP * sizeof(int));
+        for (int i = 0; i < N_HEAP; i++)
+                values[i] = rand();
+
+        double start = now();
+        heap_t *h = heap_init(sizeof(int), compare_int);
+        for (int i = 0; i < N_HEAP; i++)
+                heap_add(h, &values[i]);
+        int x;
+        while (heap_pop_min(h, &x))
+                ;
+        double generic = now() - start;
+        heap_free(h);
+
+        start = now();
+        intheap_t *th = intheap_init();
+        for (int i = 0; i < N_HEAP; i++)
+                intheap_add(th, values[i]);
+        while (intheap_pop_min(th, &x))
+                ;
+        double typed = now() - start;
+        intheap_free(th);
+
+        printf("%-20s %8.1f ns/element\n", "heap_t", generic * 1e9 / N_HEAP);
+        printf("%-20s %8.1f ns/element\n", "GDS_DEFINE_HEAP", typed * 1e9 / N_HEAP);
+        free(values);
+}
+
+int main(void){
+        printf("[typed bench: append and read %d ints]\n", N_ELEMENTS);
+        bench_vector();
+        printf("[typed bench: add and pop %d ints]\n", N_HEAP);
+        bench_heap();
+        return 0;
+}
@@ -15,7 +15,19 @@ extern "C" {
 
 #include "avl_tree.h"
 #include "heap.h"
-#include "dictionary.h"
+#include "hash_map.h"
+#include "frozen_hash_map.h"
+#include "hash_multimap.h"
+#include "interner.h"
+#include "typed_hash_map.h"
+#include "typed_vector.h"
+#include "typed_heap.h"
+#include "hash_set.h"
+#include "concurrent_hash_map.h"
+#include "rcu_hash_map.h"
+#include "cuckoo_hash_map.h"
+#include "lru_cache.h"
+#include "tinylfu_cache.h"
 #include "graph.h"
 #include "linked_list.h"
 #include "queue.h"
@@ -0,0 +1,130 @@
+/*
+ * concurrent_hash_map.h - concurrent_hashmap_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "hash_map.h"
+
+/**
+ * Thread safe hash map.
+ * The key space is split into shards. Each shard is a regular
+ * hash_map_t protected by its own reader-writer lock, so threads
+ * working on different shards never wait for each other, and
+ * readers of the same shard can run in parallel.
+ */
+typedef struct concurrent_hash_map concurrent_hashmap_t;
+
+/**
+ * Function used by concurrent_hashmap_compute_if_absent to build
+ * the value of a key that is not in the map.
+ * @param key the key being inserted
+ * @param value buffer to write the new value into
+ * @param ctx the argument given to concurrent_hashmap_compute_if_absent
+ * @return GDS_SUCCESS to insert the value. Any other value cancels the insertion.
+ */
+typedef int (*compute_function_t) (const void *key, void *value, void *ctx);
+
+#define CONCURRENT_HASHMAP_DEF_SHARDS 64
+
+/**
+ * Initializes a concurrent_hashmap.
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ * @param n_shards number of shards. It's rounded up to a power of two.
+ *                 Pass 0 to use CONCURRENT_HASHMAP_DEF_SHARDS.
+ */
+NONNULL()
+concurrent_hashmap_t* concurrent_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t n_shards);
+
+/**
+ * Configures every shard of the map. See hashmap_configure.
+ * @note Not thread safe. Call it before sharing the map.
+ */
+NONNULL()
+int concurrent_hashmap_configure(concurrent_hashmap_t *map, enum Redispersion redispersion, double min_lf, double max_lf);
+
+/**
+ * Sets the destructor for value type.
+ * @note Not thread safe. Call it before sharing the map.
+ */
+NONNULL(1)
+void concurrent_hashmap_set_destructor(concurrent_hashmap_t *map, destructor_function_t value_destructor);
+
+/**
+ * Puts the a key-value pair in the map
+ */
+NONNULL(1,2)
+int concurrent_hashmap_put(concurrent_hashmap_t *map, void *key, void *value);
+
+/**
+ * Copies the value for the given key into dest.
+ * @return dest, or NULL if the key doesn't exist in the map
+ * @note Unlike hashmap_get_ref, there's no way to get a reference to the value,
+ *       since another thread could remove it while it's being used.
+ */
+NONNULL()
+void* concurrent_hashmap_get(concurrent_hashmap_t *map, void *key, void *dest);
+
+/**
+ * Returns true if the key exists in the map
+ */
+NONNULL()
+bool concurrent_hashmap_exists(concurrent_hashmap_t *map, void *key);
+
+/**
+ * Atomically inserts a value for the key, if it's not already in the map.
+ * The value is built by calling compute(key, value, ctx) while the shard is locked,
+ * so it's called at most once per key, even if many threads race to insert it.
+ * @param dest if not NULL, the value for the key (the existing one, or the new one)
+ *             is copied into it.
+ * @param inserted if not NULL, it's set to true if the value was inserted by this call.
+ * @return GDS_SUCCESS, or the status returned by compute if it failed.
+ */
+NONNULL(1,2,4)
+int concurrent_hashmap_compute_if_absent(concurrent_hashmap_t *map, void *key, void *dest,
+                                         compute_function_t compute, void *ctx, bool *inserted);
+
+/**
+ * Removes a key from the map
+ */
+NONNULL()
+int concurrent_hashmap_remove(concurrent_hashmap_t *map, void *key);
+
+/**
+ * Returns the number of elements in the map.
+ * The shards are locked one after the other, so if other threads
+ * are modifying the map, the result is only an approximation.
+ */
+NONNULL()
+size_t concurrent_hashmap_length(concurrent_hashmap_t *map);
+
+/**
+ * Removes all elements from the map
+ */
+void concurrent_hashmap_clear(concurrent_hashmap_t *map);
+
+void concurrent_hashmap_free(concurrent_hashmap_t *map, ...);
+
+/**
+ * Frees all the given maps.
+ */
+#define concurrent_hashmap_free(...) concurrent_hashmap_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * cuckoo_hash_map.h - cuckoo_hashmap_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef CUCKOO_HASH_MAP_H
+#define CUCKOO_HASH_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "attrs.h"
+
+/**
+ * Bucketized cuckoo hash map.
+ * Every key can only live in one of two buckets of 4 slots, so a
+ * lookup checks at most 8 slots, no matter how full the table is.
+ * When both buckets are full, an insertion makes room by moving
+ * other keys to their alternative bucket.
+ *
+ * Use it instead of hash_map_t when the worst case latency of
+ * a lookup matters more than the speed of the insertions.
+ */
+typedef struct cuckoo_hash_map cuckoo_hashmap_t;
+
+/**
+ * Initializes a cuckoo_hashmap
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values
+ * @param hash_func hash function for the keys. Since both buckets are
+ *                  derived from it, it must be a good one (see hash_u32_mix).
+ * @param cmp Comparator function
+ */
+NONNULL()
+cuckoo_hashmap_t* cuckoo_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Initializes a cuckoo_hashmap with room for, at least, [capacity] elements
+ */
+NONNULL()
+cuckoo_hashmap_t* cuckoo_hashmap_with_capacity(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity);
+
+/**
+ * Sets the destructor for value type.
+ * A NULL parameter means there's no destructor.
+ */
+NONNULL(1)
+void cuckoo_hashmap_set_destructor(cuckoo_hashmap_t *map, destructor_function_t value_destructor);
+
+/**
+ * Puts the a key-value pair in the map
+ */
+NONNULL(1,2)
+int cuckoo_hashmap_put(cuckoo_hashmap_t *map, void *key, void *value);
+
+/**
+ * Copies the value for the given key into dest.
+ * @return dest, or NULL if the key doesn't exist in the map
+ */
+NONNULL()
+void* cuckoo_hashmap_get(const cuckoo_hashmap_t *map, void *key, void *dest);
+
+/**
+ * Returns a reference to the value of this key, or NULL
+ * if the key doesn't exist in the map.
+ * The reference is valid until the next put or remove.
+ */
+NONNULL()
+void* cuckoo_hashmap_get_ref(const cuckoo_hashmap_t *map, void *key);
+
+/**
+ * Returns true if the key exists in the map
+ */
+NONNULL()
+bool cuckoo_hashmap_exists(const cuckoo_hashmap_t *map, void *key);
+
+/**
+ * Removes a key from the map
+ */
+NONNULL()
+int cuckoo_hashmap_remove(cuckoo_hashmap_t *map, void *key);
+
+NONNULL()
+size_t cuckoo_hashmap_length(const cuckoo_hashmap_t *map);
+
+/**
+ * Removes all elements from the map
+ */
+void cuckoo_hashmap_clear(cuckoo_hashmap_t *map);
+
+void cuckoo_hashmap_free(cuckoo_hashmap_t *map, ...);
+
+/**
+ * Frees all the given maps.
+ */
+#define cuckoo_hashmap_free(...) cuckoo_hashmap_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,7 @@ typedef enum gds_return {
         GDS_REPEATED_ELEMENT_ERROR  = -0xE003,
         GDS_INVALID_PARAMETER_ERROR = -0xE004,
         GDS_NOMEM_ERROR = -0xE005,
+        GDS_READ_ONLY_ERROR = -0xE006,
 } gds_return_t;
 
 // If it's not already defined, define a macro for the base name of the file
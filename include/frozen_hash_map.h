@@ -0,0 +1,89 @@
+/*
+ * frozen_hash_map.h - frozen_hashmap_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef FROZEN_HASH_MAP_H
+#define FROZEN_HASH_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "hash_map.h"
+#include "attrs.h"
+
+/**
+ * Read only map, built from a fixed set of keys.
+ * It uses a minimal perfect hash function: every key is mapped to a
+ * different position of an array with exactly one entry per key, so
+ * there are no collisions to resolve. A lookup is one call to the hash
+ * function, one access to a small table of parameters, and one key
+ * comparison. Besides the entries, it only needs a few bits per key.
+ */
+typedef struct frozen_hash_map frozen_hashmap_t;
+
+/**
+ * Builds a frozen_hashmap from an array of keys and an array of values.
+ * @param keys array of n keys. They must all be different.
+ * @param values array of n values. Can be NULL if value_size is 0.
+ * @param hash_func hash function for the keys. Different keys must have
+ *                  different hashes, so it's recommended to use the 64 bit
+ *                  hashes of hash.h (hash_u32_mix, hash_string_fast...).
+ * @return the map, or NULL if a key is repeated, two keys have the same
+ *         hash, or there's not enough memory.
+ */
+NONNULL(1,6,7)
+frozen_hashmap_t* frozen_hashmap_from_arrays(const void *keys, const void *values, size_t n, size_t key_size, size_t value_size,
+                                             hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Builds a frozen_hashmap with the keys and values of the hash_map,
+ * and the same hash function and comparator. The hash_map is not modified.
+ * The values are copied byte by byte, so if they own memory, both maps
+ * share it.
+ * @return the map, or NULL on error (see frozen_hashmap_from_arrays).
+ *         Maps with string keys (hashmap_init_string_keys) can't be frozen.
+ */
+NONNULL()
+frozen_hashmap_t* hashmap_freeze(const hash_map_t *map);
+
+/**
+ * Copies the value for the given key into dest.
+ * @return dest, or NULL if the key doesn't exist in the map
+ */
+NONNULL()
+void* frozen_hashmap_get(const frozen_hashmap_t *map, const void *key, void *dest);
+
+/**
+ * Returns a reference to the value of this key, or NULL
+ * if the key doesn't exist in the map.
+ */
+NONNULL()
+const void* frozen_hashmap_get_ref(const frozen_hashmap_t *map, const void *key);
+
+/**
+ * Returns true if the key exists in the map
+ */
+NONNULL()
+bool frozen_hashmap_exists(const frozen_hashmap_t *map, const void *key);
+
+NONNULL()
+size_t frozen_hashmap_length(const frozen_hashmap_t *map);
+
+void frozen_hashmap_free(frozen_hashmap_t *map, ...);
+
+/**
+ * Frees all the given maps.
+ */
+#define frozen_hashmap_free(...) frozen_hashmap_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -11,6 +11,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define HASH_COMBINE(h1, h2)
 
@@ -35,6 +36,61 @@ hashcode_t hash_string(const void *arg);
 
 hashcode_t hash_ptr(const void *arg);
 
+/**
+ * Returns the seed used by the hash functions below.
+ * It's chosen at random the first time it's needed, so the hashes
+ * change on every run of the program. This makes it hard for an
+ * attacker to craft keys that collide (hash flooding).
+ */
+hashcode_t hash_seed(void);
+
+/**
+ * Sets the seed returned by hash_seed. Useful to get
+ * reproducible hashes, for example in tests.
+ * @note Hash maps built with the previous seed must not be used after this.
+ */
+void hash_set_seed(hashcode_t seed);
+
+/**
+ * Hashes len bytes starting at ptr. Based on wyhash.
+ * Reads 8 bytes at a time, and mixes them with 64x64->128 bit multiplications.
+ */
+hashcode_t hash_bytes(const void *ptr, size_t len, hashcode_t seed);
+
+/**
+ * Like hash_string, but word at a time, and seeded with hash_seed().
+ * Much faster for long strings, and with a better distribution.
+ */
+hashcode_t hash_string_fast(const void *arg);
+
+/**
+ * Hashes an uint32_t (or int) with a strong finalizer (splitmix64),
+ * seeded with hash_seed(). Unlike hash_int, consecutive keys don't
+ * get consecutive hashes.
+ */
+hashcode_t hash_u32_mix(const void *arg);
+
+/**
+ * Hashes an uint64_t (or long long) with a strong finalizer
+ * (splitmix64), seeded with hash_seed().
+ */
+hashcode_t hash_u64_mix(const void *arg);
+
+/**
+ * Defines a hash function for a plain data type (for example, a struct
+ * without pointers), that hashes all of its bytes with hash_bytes.
+ * The type must not have padding, or the padding must always be zeroed.
+ *
+ * Example:
+ *      struct point { int x, y; };
+ *      GDS_DEFINE_POD_HASH(hash_point, struct point)
+ *      hash_map_t *map = hashmap_init(sizeof(struct point), sizeof(int), hash_point, compare_point);
+ */
+#define GDS_DEFINE_POD_HASH(name, type) \
+        static hashcode_t name(const void *arg) { \
+                return hash_bytes(arg, sizeof(type), hash_seed()); \
+        }
+
 #ifdef __cplusplus
 }
 #endif
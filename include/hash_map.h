@@ -18,8 +18,33 @@ extern "C" {
 
 typedef struct hash_map hash_map_t;
 
+/**
+ * Kind of redispersion (probe sequence) used to resolve collisions.
+ * - LINEAR_HASHING: tries the next slot.
+ * - QUADRATIC_HASHING: tries the slot n*n positions away.
+ * - SWISS_HASHING: like LINEAR_HASHING, but checks GROUP_WIDTH (16) slots
+ *                  at a time, using SIMD instructions when available.
+ *                  Best for workloads with a lot of failed lookups.
+ * - ROBIN_HOOD_HASHING: linear probing that keeps the distance of every element
+ *                       to its home position balanced, and removes elements by
+ *                       shifting the following ones back, instead of leaving
+ *                       DELETED marks. Lookup times stay stable under lots of
+ *                       puts and removes.
+ */
 enum Redispersion{
-        LINEAR_HASHING, QUADRATIC_HASHING,
+        LINEAR_HASHING, QUADRATIC_HASHING, SWISS_HASHING, ROBIN_HOOD_HASHING,
+};
+
+/**
+ * How the capacity of the hash_map is chosen.
+ * - PRIME_SIZING: prime capacities. The position of a key is hash % capacity.
+ *                 Works well even with weak hash functions.
+ * - POW2_SIZING: power of two capacities. The hash is mixed with a multiplicative
+ *                (Fibonacci) finalizer, and the position is taken from its top
+ *                bits, so there's no division when probing.
+ */
+enum Sizing {
+        PRIME_SIZING, POW2_SIZING,
 };
 
 /**
@@ -33,6 +58,22 @@ enum Redispersion{
 NONNULL()
 hash_map_t* hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp);
 
+/**
+ * Initializes a hash_map with string keys.
+ * Like with hash_string, a key is passed as a pointer to a char*.
+ * The map copies the bytes of the strings it stores into an arena
+ * it owns, along with their length, so the caller doesn't have to
+ * keep them alive. The hash is computed once per operation, and a
+ * stored key is only compared with memcmp if its hash and length
+ * match the ones of the key being looked for.
+ * The keys given to the caller (hashmap_keys, iterators...) point
+ * to the copies, which are valid while the map is not freed or cleared.
+ * @note The memory of removed keys is only reclaimed by hashmap_clear.
+ *       hashmap_save and hashmap_freeze are not supported for these maps.
+ * @param value_size size in bytes of the values
+ */
+hash_map_t* hashmap_init_string_keys(size_t value_size);
+
 /**
  * Initializes a hash_map with an initial capacity
  * @param key_size size in bytes of the keys
@@ -47,16 +88,36 @@ hash_map_t* hashmap_with_capacity(size_t key_size, size_t value_size, hash_funct
 
 #define DICT_NO_SHRINKING        -1.0f
 #define DICT_DEF_REDISPERSION        LINEAR_HASHING
+#define DICT_KEEP_REDISPERSION       ((enum Redispersion) -1)
 #define DICT_DEF_MAX_LF                0.8f
 #define DICT_DEF_MIN_LF                0.1f
+#define DICT_NO_COMPACTION      -1.0f
+#define DICT_DEF_MAX_DELETED    0.2f
+
+/**
+ * Builds a hash_map from an array of keys and an array of values.
+ * The table is sized once for the n elements, so it never
+ * has to redisperse while loading them. If a key is repeated,
+ * the last value wins.
+ * @param keys array of n keys
+ * @param values array of n values. Can be NULL if value_size is 0.
+ */
+NONNULL(1,6,7)
+hash_map_t* hashmap_from_arrays(const void *keys, const void *values, size_t n, size_t key_size, size_t value_size,
+                                hash_function_t hash_func, comparator_function_t cmp);
 
 /**
  * Configures the hash_map_t's behaviour.
- * @param redisperison the kind of redispersion to apply. Can be LINEAR, QUADRATIC or DOUBLE_HASHING (default value).
+ * @param redisperison the kind of redispersion to apply. Can be LINEAR (default value), QUADRATIC, SWISS_HASHING
+ *                     or ROBIN_HOOD_HASHING.
+ *                     Pass DICT_KEEP_REDISPERSION (-1) to keep the current one. Changing it on a non empty
+ *                     map redisperses its elements.
  * @param min_lf minimun value for the load factor. This means that, when deleting,
  *               if (number of elements / total size) <= min_lf, the hash_map's size is cut in half.
  * @param max_lf maximun value for the load factor. This means that, when adding,
  *               if (number of elements / total size) >= min_lf, the hash_map's size is doubled.
+ * @return GDS_SUCCESS, or GDS_INVALID_PARAMETER_ERROR if the redispersion isn't valid
+ *         or min_lf >= max_lf.
  * @note 1) You can use the macros defined in hash_map.h to pass the default values (for example, DICT_DEF_MAX_LF)
  * @note 2) You can pass 0.0f to the min_lf and max_lf to not change them, and NULL to hash_func to also use the current one.
  * @note 3) You can use DICT_NO_SHRINKING in the min_lf parameter to configure the hash_map to NOT shrink when deleting. This makes it
@@ -65,6 +126,13 @@ hash_map_t* hashmap_with_capacity(size_t key_size, size_t value_size, hash_funct
 NONNULL()
 int hashmap_configure(hash_map_t *map, enum Redispersion redispersion, double min_lf, double max_lf);
 
+/**
+ * Sets the sizing mode of the hash_map. PRIME_SIZING is the default.
+ * Changing it redisperses the elements of the hash_map.
+ */
+NONNULL()
+int hashmap_set_sizing(hash_map_t *map, enum Sizing sizing);
+
 /**
  * Sets the destructor for value type.
  * A NULL parameter means there's no destructor.
@@ -72,6 +140,67 @@ int hashmap_configure(hash_map_t *map, enum Redispersion redispersion, double mi
 NONNULL(1)
 void hashmap_set_destructor(hash_map_t *map, destructor_function_t value_destructor);
 
+/**
+ * Sets the maximun ratio of DELETED slots (tombstones) in the table.
+ * Removing an element leaves a DELETED mark in its slot (except with
+ * ROBIN_HOOD_HASHING), which makes the probe sequences that go through it
+ * longer. When a removal leaves more than [max_deleted] * capacity of them,
+ * the table is compacted (see hashmap_compact).
+ * @param max_deleted the ratio, DICT_DEF_MAX_DELETED (0.2) by default.
+ *                    DICT_NO_COMPACTION disables the automatic compaction.
+ * @return GDS_INVALID_PARAMETER_ERROR if max_deleted >= 1, or
+ *         GDS_READ_ONLY_ERROR if the map is read only
+ */
+NONNULL()
+int hashmap_set_tombstone_threshold(hash_map_t *map, double max_deleted);
+
+/**
+ * Removes all the DELETED slots of the table, rehashing the
+ * elements in place, without changing its capacity or
+ * allocating a new table.
+ * Useful after removing lots of elements with DICT_NO_SHRINKING.
+ */
+NONNULL()
+int hashmap_compact(hash_map_t *map);
+
+/**
+ * Makes sure the hash_map can hold n elements without redispersing.
+ * Call it before inserting a known number of elements, to
+ * avoid growing the table many times.
+ * @note It's based on the current max load factor. Call it
+ *       after hashmap_configure.
+ */
+NONNULL()
+int hashmap_reserve(hash_map_t *map, size_t n);
+
+/**
+ * Makes the hash_map resize incrementally.
+ * Instead of moving all the elements at once when it grows or shrinks,
+ * the hash_map keeps the previous table around, and every put or remove
+ * migrates [step] of its slots into the new one. This bounds the latency
+ * of a single operation, at the cost of looking up in two tables while
+ * a migration is in progress.
+ * @param step number of slots to migrate on every operation.
+ *             0 (the default) disables incremental rehashing, and finishes
+ *             the migration in progress, if any.
+ */
+NONNULL()
+void hashmap_set_incremental_rehash(hash_map_t *map, size_t step);
+
+/**
+ * Migrates up to [budget] slots of a pending incremental rehash.
+ * Useful to move the work to moments when the program is idle.
+ * @return true if there's still work left.
+ */
+NONNULL()
+bool hashmap_rehash_step(hash_map_t *map, size_t budget);
+
+/**
+ * Returns true if the hash_map is in the middle of an incremental rehash.
+ */
+NONNULL()
+bool hashmap_is_rehashing(const hash_map_t *map);
+
 /**
  * Puts the a key-value pair in the hash_map
 */
@@ -97,6 +226,55 @@ void* hashmap_get(const hash_map_t *map, void *key, void *dest);
 NONNULL()
 void* hashmap_get_ref(const hash_map_t *map, void *key);
 
+/**
+ * Returns a reference to the value of this key, inserting the key
+ * with a zero-initialized value if it doesn't exist.
+ * The key is looked up and inserted with a single probe sequence.
+ *
+ * Example (word count):
+ *      int *count = hashmap_entry(map, &word, NULL);
+ *      (*count)++;
+ *
+ * @param inserted if not NULL, it's set to true if the key was inserted.
+ * @return a reference to the value, valid until the next put or remove,
+ *         or NULL on error.
+ */
+NONNULL(1,2)
+void* hashmap_entry(hash_map_t *map, void *key, bool *inserted);
+
+/**
+ * Looks up n keys at once.
+ * The keys are hashed and their slots prefetched in groups, so the
+ * memory accesses of many lookups overlap. Faster than calling
+ * hashmap_get in a loop when there's a lot of keys.
+ * @param keys array of n keys
+ * @param dests array of n values. The value of the i-th key is copied
+ *              into the i-th position. Positions of missing keys are left untouched.
+ * @param found if not NULL, found[i] is set to true if the i-th key exists.
+ * @return the number of keys found
+ */
+NONNULL(1,2,4)
+size_t hashmap_get_batch(const hash_map_t *map, const void *keys, size_t n, void *dests, bool *found);
+
+/**
+ * Puts n key-value pairs at once. Like hashmap_get_batch,
+ * it hashes and prefetches the keys in groups.
+ * @param keys array of n keys
+ * @param values array of n values. Can be NULL if the value size is 0.
+ * @return GDS_SUCCESS, or the error of the first put that failed.
+ *         The pairs before it are already in the map.
+ */
+NONNULL(1,2)
+int hashmap_put_batch(hash_map_t *map, const void *keys, const void *values, size_t n);
+
+/**
+ * Returns a reference to the key stored in the map that is equal to
+ * the given one, or NULL if it doesn't exist. With string keys, it
+ * points to the map's copy of the string.
+ */
+NONNULL()
+const void* hashmap_get_key(const hash_map_t *map, void *key);
+
 /**
  * Returns a vector with all the keys to the hash_map_t
  * The vector is of the same type as the keys in the table.
@@ -118,9 +296,133 @@ bool hashmap_exists(const hash_map_t *map, void *key);
 NONNULL()
 int hashmap_remove(hash_map_t *map, void *key);
 
+/**
+ * Removes every key-value pair for which pred(key, value, args) returns false.
+ * @return the number of elements removed
+ */
+NONNULL(1,2)
+size_t hashmap_retain(hash_map_t *map, bool (*pred) (const void*,void*,void*), void *args);
+
 NONNULL()
 size_t hashmap_length(const hash_map_t *map);
 
+/**
+ * Calls func on every key-value pair of the hash_map,
+ * passing args as the third parameter.
+ * The keys must not be modified. The values can be, unless
+ * the map is read only (see hashmap_open_mmap).
+ */
+NONNULL(1,2)
+void hashmap_foreach(hash_map_t *map, void (*func) (const void*,void*,void*), void *args);
+
+typedef struct hashmap_iterator_t {
+        const hash_map_t *map;
+        size_t pos;
+} hashmap_iterator_t;
+
+/*
+ * Create an iterator of the given hash_map.
+ * The iterator walks the map in place, without allocating memory.
+ * The order of the elements is unspecified.
+ * CAUTION:
+ * DO NOT use this iterator after the original hash_map has been freed,
+ * or after putting or removing elements.
+ * */
+NONNULL()
+hashmap_iterator_t hashmap_iterator(const hash_map_t *map);
+
+/**
+ * Advances the iterator.
+ * @param key_ref if not NULL, it's set to a reference to the key.
+ * @param value_ref if not NULL, it's set to a reference to the value.
+ * @return false if there are no more elements.
+ */
+NONNULL(1)
+bool hashmap_it_next(hashmap_iterator_t *it, void **key_ref, void **value_ref);
+
+#define HASHMAP_PROBE_HISTOGRAM 16
+
+/**
+ * Statistics of a hash_map (see hashmap_stats).
+ * The probe length of an element is the number of slots checked to find it,
+ * counting its own (with SWISS_HASHING, the number of groups checked).
+ * While an incremental rehash is in progress, both tables are counted.
+ */
+typedef struct hashmap_stats {
+        size_t capacity;        ///< Number of slots
+        size_t n_full;          ///< Slots with an element
+        size_t n_deleted;       ///< Slots with a DELETED mark (tombstones)
+        size_t n_empty;         ///< Empty slots
+        double load_factor;     ///< n_full / capacity
+        double avg_probe;       ///< Average probe length
+        size_t max_probe;       ///< Maximun probe length
+        size_t p99_probe;       ///< 99th percentile of the probe lengths
+        /**
+         * probe_histogram[i] is the number of elements with a probe length of i + 1.
+         * The last position counts the elements with a probe length of
+         * HASHMAP_PROBE_HISTOGRAM or more.
+         */
+        size_t probe_histogram[HASHMAP_PROBE_HISTOGRAM];
+        size_t n_redispersions; ///< Number of times the table has been rebuilt (to grow, shrink or reconfigure it)
+        size_t bytes;           ///< Memory used by the map. The keys and values are stored inline,
+                                ///< so this doesn't include the memory they might point to.
+} hashmap_stats_t;
+
+/**
+ * Computes statistics of the hash_map: the distribution of the probe lengths,
+ * the number of full, deleted and empty slots, and the memory used.
+ * A long average probe length with a low load factor usually means a bad
+ * hash function, and a lot of deleted slots means the map needs a rehash.
+ * It checks every slot, so it's O(capacity).
+ * @return GDS_SUCCESS, or GDS_NOMEM_ERROR.
+ */
+NONNULL()
+int hashmap_stats(const hash_map_t *map, hashmap_stats_t *out);
+
+/**
+ * Returns a copy of the hash_map, with the same configuration.
+ * The keys and values are copied byte by byte. If they own memory
+ * (for example, pointers to malloc'd strings), both maps will share
+ * it, so be careful to only call the destructor from one of them.
+ */
+NONNULL()
+hash_map_t* hashmap_dup(const hash_map_t *map);
+
+/**
+ * Writes an image of the hash_map's table to a file, that
+ * hashmap_open_mmap can use as is, without parsing it.
+ * Only for keys and values that are plain data (no pointers). The
+ * image can only be opened in machines with the same architecture.
+ * @return GDS_SUCCESS, or GDS_ERROR if the file couldn't be written.
+ *         GDS_INVALID_PARAMETER_ERROR for maps with string keys.
+ */
+NONNULL()
+int hashmap_save(hash_map_t *map, const char *path);
+
+/**
+ * Opens a file written by hashmap_save as a read only hash_map.
+ * The file is mapped in memory (with mmap, if available) and the lookups
+ * work straight on its pages: there's no parsing and no allocation per
+ * element, and all the processes that open the file share its pages.
+ * @param hash_func the hash function of the saved map. The hashes are stored
+ *                  in the file, so it must return the same values it returned
+ *                  in the process that saved it. For the seeded hashes in hash.h,
+ *                  this means fixing the seed with hash_set_seed.
+ * @param cmp the comparator of the saved map
+ * @note The map is read only. The functions that modify it return
+ *       GDS_READ_ONLY_ERROR (or do nothing), and the values must not be
+ *       modified through hashmap_get_ref. Use hashmap_dup to get a modifiable copy.
+ * @return the map, or NULL if the file couldn't be opened or isn't a valid image.
+ */
+NONNULL()
+hash_map_t* hashmap_open_mmap(const char *path, hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Returns true if the hash_map was opened with hashmap_open_mmap.
+ */
+NONNULL()
+bool hashmap_is_read_only(const hash_map_t *map);
+
 /**
  * Removes all elements from the hash_map
  */
@@ -0,0 +1,162 @@
+/*
+ * hash_multimap.h - hash_multimap_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef HASH_MULTIMAP_H
+#define HASH_MULTIMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "attrs.h"
+
+/**
+ * Hash map where a key can have many values.
+ * The values of a key are stored contiguously, in a chain of fixed
+ * size blocks of about a cache line. All the blocks come from a single
+ * pool owned by the multimap, so adding a value to a key doesn't
+ * allocate memory unless the pool has to grow.
+ */
+typedef struct hash_multimap hash_multimap_t;
+
+/**
+ * Initializes a multimap
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values. Must be greater than 0.
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ */
+NONNULL()
+hash_multimap_t* multimap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Sets the destructor for value type.
+ * A NULL parameter means there's no destructor.
+ */
+NONNULL(1)
+void multimap_set_destructor(hash_multimap_t *map, destructor_function_t value_destructor);
+
+/**
+ * Adds the value to the ones of the key.
+ * The values of a key are kept in insertion order, unless one of them
+ * is removed with multimap_remove_value.
+ * @return GDS_SUCCESS or an error code
+ */
+NONNULL()
+int multimap_put(hash_multimap_t *map, void *key, void *value);
+
+/**
+ * Adds n values to the ones of the key, with a single lookup.
+ * @param values array of n values
+ * @return GDS_SUCCESS or an error code. On error, the map is unchanged.
+ */
+NONNULL()
+int multimap_put_values(hash_multimap_t *map, void *key, const void *values, size_t n);
+
+/**
+ * Puts n key-value pairs at once. Consecutive pairs with the same key
+ * are added with a single lookup, so it's faster if the pairs are
+ * grouped by key.
+ * @param keys array of n keys
+ * @param values array of n values
+ * @return GDS_SUCCESS, or the error of the first put that failed.
+ *         The pairs before it are already in the map.
+ */
+NONNULL()
+int multimap_put_batch(hash_multimap_t *map, const void *keys, const void *values, size_t n);
+
+/**
+ * Returns the number of values of the key
+ */
+NONNULL()
+size_t multimap_count(const hash_multimap_t *map, void *key);
+
+/**
+ * Returns true if the key has at least one value
+ */
+NONNULL()
+bool multimap_exists(const hash_multimap_t *map, void *key);
+
+/**
+ * Removes the key and all its values.
+ * @return GDS_SUCCESS, or GDS_ELEMENT_NOT_FOUND_ERROR if the key doesn't exist
+ */
+NONNULL()
+int multimap_remove(hash_multimap_t *map, void *key);
+
+/**
+ * Removes one value of the key. The values are compared byte by byte.
+ * The last value of the key takes the place of the removed one.
+ * If it was the only value of the key, the key is removed too.
+ * @return GDS_SUCCESS, or GDS_ELEMENT_NOT_FOUND_ERROR if the
+ *         key doesn't have that value
+ */
+NONNULL()
+int multimap_remove_value(hash_multimap_t *map, void *key, void *value);
+
+/**
+ * Returns the total number of values in the multimap
+ */
+NONNULL()
+size_t multimap_length(const hash_multimap_t *map);
+
+/**
+ * Returns the number of different keys in the multimap
+ */
+NONNULL()
+size_t multimap_n_keys(const hash_multimap_t *map);
+
+typedef struct multimap_range_t {
+        const hash_multimap_t *map;
+        unsigned block;
+        unsigned pos;
+} multimap_range_t;
+
+/*
+ * Returns the range of values of the key, like C++'s equal_range.
+ * If the key doesn't exist, the range is empty.
+ * CAUTION:
+ * DO NOT use the range after the multimap has been freed,
+ * or after putting or removing elements.
+ * */
+NONNULL()
+multimap_range_t multimap_equal_range(const hash_multimap_t *map, void *key);
+
+/**
+ * Returns a reference to the next value of the range,
+ * or NULL if there are no more values.
+ */
+NONNULL()
+void* multimap_range_next(multimap_range_t *range);
+
+/**
+ * Returns the next run of contiguous values of the range, and
+ * advances the range past it. Faster than multimap_range_next
+ * to go through a lot of values.
+ * @param n set to the number of values in the run
+ * @return a reference to the first value of the run,
+ *         or NULL if there are no more values.
+ */
+NONNULL()
+void* multimap_range_next_run(multimap_range_t *range, size_t *n);
+
+void multimap_clear(hash_multimap_t *map);
+
+void multimap_free(hash_multimap_t *map, ...);
+
+/**
+ * Frees all the given multimaps.
+ */
+#define multimap_free(...) multimap_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * hash_set.h - hashset_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef HASH_SET_H
+#define HASH_SET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "vector.h"
+#include "attrs.h"
+
+#ifndef hashset_t
+typedef struct hash_set hashset_t;
+#endif
+
+/**
+ * Initializes a hashset
+ * @param key_size size in bytes of the keys
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ */
+NONNULL()
+hashset_t* hashset_init(size_t key_size, hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Initializes a hashset with an initial capacity
+ */
+NONNULL()
+hashset_t* hashset_with_capacity(size_t key_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity);
+
+/**
+ * Adds a key to the set
+ * @return GDS_SUCCESS, or GDS_REPEATED_ELEMENT_ERROR if it was already in the set.
+ */
+NONNULL()
+int hashset_add(hashset_t *set, void *key);
+
+/**
+ * Returns true if the key is in the set
+ */
+NONNULL()
+bool hashset_contains(const hashset_t *set, void *key);
+
+/**
+ * Removes a key from the set
+ */
+NONNULL()
+int hashset_remove(hashset_t *set, void *key);
+
+NONNULL()
+size_t hashset_length(const hashset_t *set);
+
+/**
+ * Returns a vector with all the keys of the set
+ */
+NONNULL()
+vector_t* hashset_keys(const hashset_t *set);
+
+/**
+ * Returns a new set with the keys that are in a, b, or both.
+ * Both sets must have the same key type, hash and comparator.
+ */
+NONNULL()
+hashset_t* hashset_union(const hashset_t *a, const hashset_t *b);
+
+/**
+ * Returns a new set with the keys that are both in a and b.
+ */
+NONNULL()
+hashset_t* hashset_intersection(const hashset_t *a, const hashset_t *b);
+
+/**
+ * Returns a new set with the keys of a that are not in b.
+ */
+NONNULL()
+hashset_t* hashset_difference(const hashset_t *a, const hashset_t *b);
+
+/**
+ * Removes all elements from the set
+ */
+void hashset_clear(hashset_t *set);
+
+void hashset_free(hashset_t *set, ...);
+
+/**
+ * Frees all the given sets.
+ */
+#define hashset_free(...) hashset_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * interner.h - interner_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "attrs.h"
+
+/**
+ * String interner.
+ * Gives every different string a small integer id: 0 to the first
+ * one, 1 to the second... Repeated strings get the same id, so the
+ * ids can be used as keys instead of the strings, and two strings
+ * are equal if and only if their ids are.
+ * The interner keeps its own copy of every string.
+ */
+typedef struct interner interner_t;
+
+/**
+ * Returned by interner_find for strings that aren't interned,
+ * and by interner_intern on error.
+ */
+#define INTERNER_NOT_FOUND SIZE_MAX
+
+interner_t* interner_init(void);
+
+/**
+ * Returns the id of the string, giving it a new one if
+ * it's the first time it's interned.
+ * @return the id, or INTERNER_NOT_FOUND if there's not enough memory.
+ */
+NONNULL()
+size_t interner_intern(interner_t *interner, const char *str);
+
+/**
+ * Returns the id of the string, or INTERNER_NOT_FOUND if it
+ * hasn't been interned.
+ */
+NONNULL()
+size_t interner_find(const interner_t *interner, const char *str);
+
+/**
+ * Returns the interner's copy of the string with the given id,
+ * or NULL if there's no such id.
+ */
+NONNULL()
+const char* interner_string(const interner_t *interner, size_t id);
+
+/**
+ * Returns the number of strings interned.
+ */
+NONNULL()
+size_t interner_length(const interner_t *interner);
+
+void interner_free(interner_t *interner, ...);
+
+/**
+ * Frees all the given interners.
+ */
+#define interner_free(...) interner_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
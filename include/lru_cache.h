@@ -0,0 +1,124 @@
+/*
+ * lru_cache.h - lru_cache_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "attrs.h"
+
+/**
+ * Least Recently Used cache with a fixed capacity.
+ * The entries live in a pool allocated once, with the links of the
+ * recency list stored next to them, and a hash_map from the keys to
+ * their position in the pool. A get is a single lookup, and no
+ * operation allocates memory once the cache is created.
+ * When the cache is full, a put evicts the least recently used entry.
+ */
+typedef struct lru_cache lru_cache_t;
+
+/**
+ * Hit, miss and eviction counters of a cache.
+ * Only lru_cache_get and lru_cache_get_ref count as hits or misses.
+ */
+typedef struct lru_cache_stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+} lru_cache_stats_t;
+
+/**
+ * Initializes a lru_cache
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ * @param capacity maximun number of entries in the cache. Must be greater than 0.
+ */
+NONNULL()
+lru_cache_t* lru_cache_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity);
+
+/**
+ * Sets the destructor for value type.
+ * It's called on the values that are evicted, replaced or removed
+ * from the cache, so it can be used as an eviction callback.
+ * A NULL parameter means there's no destructor.
+ */
+NONNULL(1)
+void lru_cache_set_destructor(lru_cache_t *cache, destructor_function_t value_destructor);
+
+/**
+ * Puts the key-value pair in the cache, as the most recently used.
+ * If the cache is full, the least recently used entry is evicted.
+ */
+NONNULL(1,2)
+int lru_cache_put(lru_cache_t *cache, void *key, void *value);
+
+/**
+ * Copies the value for the given key into dest, and marks
+ * it as the most recently used.
+ * @return dest, or NULL if the key isn't in the cache
+ */
+NONNULL()
+void* lru_cache_get(lru_cache_t *cache, void *key, void *dest);
+
+/**
+ * Like lru_cache_get, but returns a reference to the value.
+ * The reference is valid until the entry is evicted or removed.
+ */
+NONNULL()
+void* lru_cache_get_ref(lru_cache_t *cache, void *key);
+
+/**
+ * Returns true if the key is in the cache.
+ * Unlike lru_cache_get, it doesn't change the order of
+ * the entries, nor the hit and miss counters.
+ */
+NONNULL()
+bool lru_cache_exists(const lru_cache_t *cache, void *key);
+
+/**
+ * Removes a key from the cache
+ */
+NONNULL()
+int lru_cache_remove(lru_cache_t *cache, void *key);
+
+NONNULL()
+size_t lru_cache_length(const lru_cache_t *cache);
+
+NONNULL()
+size_t lru_cache_capacity(const lru_cache_t *cache);
+
+/**
+ * Returns the hit, miss and eviction counters of the cache.
+ */
+NONNULL()
+lru_cache_stats_t lru_cache_stats(const lru_cache_t *cache);
+
+/**
+ * Removes all entries from the cache.
+ * The counters are not reset.
+ */
+void lru_cache_clear(lru_cache_t *cache);
+
+void lru_cache_free(lru_cache_t *cache, ...);
+
+/**
+ * Frees all the given caches.
+ */
+#define lru_cache_free(...) lru_cache_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
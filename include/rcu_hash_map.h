@@ -0,0 +1,144 @@
+/*
+ * rcu_hash_map.h - rcu_hashmap_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef RCU_HASH_MAP_H
+#define RCU_HASH_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "hash_map.h"
+
+/**
+ * Read-mostly hash map, with lock free readers.
+ *
+ * The elements live in an immutable hash_map_t (a snapshot). Readers
+ * look up in the current snapshot with a single atomic pointer load,
+ * and never wait for writers. Writers copy the snapshot, apply their
+ * changes to the copy, and publish it. The old snapshot is freed once
+ * every reader has gone through a quiescent state (QSBR): a point where
+ * it promises to hold no references into the map.
+ *
+ * Writes copy the whole table, so this map is only a good fit when
+ * reads vastly outnumber writes.
+ *
+ * @note Values are copied byte by byte between snapshots, so they must be
+ *       plain data. There's no destructor.
+ */
+typedef struct rcu_hash_map rcu_hashmap_t;
+
+/**
+ * Handle of a reader thread.
+ */
+typedef struct rcu_reader rcu_reader_t;
+
+/**
+ * Initializes a rcu_hashmap.
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ */
+NONNULL()
+rcu_hashmap_t* rcu_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp);
+
+/**
+ * Registers the calling thread as a reader.
+ * Every thread that reads from the map must be registered, and
+ * call rcu_hashmap_quiescent periodically, or the old snapshots
+ * will never be freed.
+ */
+NONNULL()
+rcu_reader_t* rcu_hashmap_register_reader(rcu_hashmap_t *map);
+
+/**
+ * Unregisters a reader. It must not hold any reference into the map.
+ */
+NONNULL()
+void rcu_hashmap_unregister_reader(rcu_hashmap_t *map, rcu_reader_t *reader);
+
+/**
+ * Announces that the reader holds no references into the map.
+ * All the references returned by rcu_hashmap_get_ref before
+ * this call become invalid.
+ */
+NONNULL()
+void rcu_hashmap_quiescent(rcu_hashmap_t *map, rcu_reader_t *reader);
+
+/**
+ * Returns a reference to the value of this key, or NULL if it doesn't exist.
+ * The reference is valid until the next call to rcu_hashmap_quiescent.
+ * @note The value must not be modified.
+ */
+NONNULL()
+const void* rcu_hashmap_get_ref(const rcu_hashmap_t *map, void *key);
+
+/**
+ * Copies the value for the given key into dest.
+ * @return dest, or NULL if the key doesn't exist in the map
+ */
+NONNULL()
+void* rcu_hashmap_get(const rcu_hashmap_t *map, void *key, void *dest);
+
+/**
+ * Returns true if the key exists in the map
+ */
+NONNULL()
+bool rcu_hashmap_exists(const rcu_hashmap_t *map, void *key);
+
+/**
+ * Returns the number of elements in the current snapshot.
+ */
+NONNULL()
+size_t rcu_hashmap_length(const rcu_hashmap_t *map);
+
+/**
+ * Puts the a key-value pair in the map, and publishes a new snapshot.
+ */
+NONNULL(1,2)
+int rcu_hashmap_put(rcu_hashmap_t *map, void *key, void *value);
+
+/**
+ * Removes a key from the map, and publishes a new snapshot.
+ */
+NONNULL()
+int rcu_hashmap_remove(rcu_hashmap_t *map, void *key);
+
+/**
+ * Applies many changes in a single snapshot.
+ * update is called with a private copy of the current snapshot. If
+ * it returns GDS_SUCCESS, the copy is published. Otherwise, it's discarded.
+ * @return the value returned by update.
+ */
+NONNULL(1,2)
+int rcu_hashmap_update(rcu_hashmap_t *map, int (*update) (hash_map_t *draft, void *ctx), void *ctx);
+
+/**
+ * Waits until every reader has gone through a quiescent
+ * state, and frees all the old snapshots.
+ * @note Must not be called from a registered reader thread,
+ *       since it would wait for itself.
+ */
+NONNULL()
+void rcu_hashmap_synchronize(rcu_hashmap_t *map);
+
+void rcu_hashmap_free(rcu_hashmap_t *map, ...);
+
+/**
+ * Frees all the given maps.
+ * There must be no registered readers left.
+ */
+#define rcu_hashmap_free(...) rcu_hashmap_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
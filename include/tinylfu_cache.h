@@ -0,0 +1,131 @@
+/*
+ * tinylfu_cache.h - tinylfu_cache_t definition.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef TINYLFU_CACHE_H
+#define TINYLFU_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "compare.h"
+#include "attrs.h"
+
+/**
+ * Frequency aware cache with a fixed capacity (W-TinyLFU).
+ * New entries go to a small LRU window. When they leave it, they only
+ * get into the main area if they have been accessed more often than
+ * the entry that would be evicted to make room for them. The access
+ * frequencies are estimated with a compact count-min sketch, which is
+ * periodically halved so old popularity fades away.
+ * The main area is a segmented LRU: a probation segment, and a protected
+ * segment for the entries that have been hit while in probation.
+ *
+ * Compared to lru_cache_t, a burst of keys that are used only once
+ * (for example, a scan) can't push the popular keys out of the cache.
+ * All the operations are O(1), and don't allocate memory.
+ */
+typedef struct tinylfu_cache tinylfu_cache_t;
+
+/**
+ * Hit, miss and eviction counters of a cache.
+ * Only tinylfu_cache_get and tinylfu_cache_get_ref count as hits or misses.
+ * The evictions include the new entries that were not admitted.
+ */
+typedef struct tinylfu_cache_stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+} tinylfu_cache_stats_t;
+
+/**
+ * Initializes a tinylfu_cache
+ * @param key_size size in bytes of the keys
+ * @param value_size size in bytes of the values
+ * @param hash_func hash function for the keys
+ * @param cmp Comparator function
+ * @param capacity maximun number of entries in the cache. Must be greater than 0.
+ */
+NONNULL()
+tinylfu_cache_t* tinylfu_cache_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity);
+
+/**
+ * Sets the destructor for value type.
+ * It's called on the values that are evicted (or not admitted),
+ * replaced or removed from the cache.
+ * A NULL parameter means there's no destructor.
+ */
+NONNULL(1)
+void tinylfu_cache_set_destructor(tinylfu_cache_t *cache, destructor_function_t value_destructor);
+
+/**
+ * Puts the key-value pair in the cache.
+ * If the cache is full, this evicts an entry, that might be the
+ * least recently used entry of the window, if it's not used often enough.
+ */
+NONNULL(1,2)
+int tinylfu_cache_put(tinylfu_cache_t *cache, void *key, void *value);
+
+/**
+ * Copies the value for the given key into dest.
+ * Hit or miss, the access is recorded in the frequency sketch.
+ * @return dest, or NULL if the key isn't in the cache
+ */
+NONNULL()
+void* tinylfu_cache_get(tinylfu_cache_t *cache, void *key, void *dest);
+
+/**
+ * Like tinylfu_cache_get, but returns a reference to the value.
+ * The reference is valid until the entry is evicted or removed.
+ */
+NONNULL()
+void* tinylfu_cache_get_ref(tinylfu_cache_t *cache, void *key);
+
+/**
+ * Returns true if the key is in the cache.
+ * It doesn't count as an access.
+ */
+NONNULL()
+bool tinylfu_cache_exists(const tinylfu_cache_t *cache, void *key);
+
+/**
+ * Removes a key from the cache
+ */
+NONNULL()
+int tinylfu_cache_remove(tinylfu_cache_t *cache, void *key);
+
+NONNULL()
+size_t tinylfu_cache_length(const tinylfu_cache_t *cache);
+
+NONNULL()
+size_t tinylfu_cache_capacity(const tinylfu_cache_t *cache);
+
+/**
+ * Returns the hit, miss and eviction counters of the cache.
+ */
+NONNULL()
+tinylfu_cache_stats_t tinylfu_cache_stats(const tinylfu_cache_t *cache);
+
+/**
+ * Removes all entries from the cache.
+ * The counters and the frequency sketch are not reset.
+ */
+void tinylfu_cache_clear(tinylfu_cache_t *cache);
+
+void tinylfu_cache_free(tinylfu_cache_t *cache, ...);
+
+/**
+ * Frees all the given caches.
+ */
+#define tinylfu_cache_free(...) tinylfu_cache_free(__VA_ARGS__, 0L)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,341 @@
+/*
+ * typed_hash_map.h - Type-specialized hash maps.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef TYPED_HASH_MAP_H
+#define TYPED_HASH_MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+
+#if defined(__SSE2__) && !defined(GDS_NO_SIMD)
+#include <emmintrin.h>
+#define GDS_TYPED_SSE2
+#endif
+
+/*
+ * The maps generated by GDS_DEFINE_HASHMAP probe like a hash_map_t
+ * with SWISS_HASHING and POW2_SIZING: a control byte per slot, with 7
+ * bits of the hash, matched GDS_GROUP_WIDTH slots at a time, and the
+ * home position taken from the top bits of the hash times the Fibonacci
+ * multiplier. These helpers are shared by all the generated maps.
+ */
+#define GDS_GROUP_WIDTH 16
+#define GDS_CTRL_EMPTY   ((uint8_t) 0x80)
+#define GDS_CTRL_DELETED ((uint8_t) 0xFE)
+
+/**
+ * Strong 64 bit mixer (the splitmix64 finalizer).
+ * A good hash_expr for integer keys.
+ */
+static inline uint64_t gds_mix64(uint64_t x){
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+}
+
+static inline uint8_t gds_ctrl_h2(uint64_t hash){
+        return (uint8_t) ((hash * 0xC2B2AE3D27D4EB4FULL) >> 57);
+}
+
+static inline size_t gds_home_pos(uint64_t hash, unsigned shift){
+        return (size_t) ((hash * 0x9E3779B97F4A7C15ULL) >> shift);
+}
+
+#ifdef GDS_TYPED_SSE2
+
+static inline uint32_t gds_group_match(const uint8_t *group, uint8_t h2){
+        __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) h2)));
+}
+
+static inline uint32_t gds_group_match_free(const uint8_t *group){
+        return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+}
+
+#else
+
+static inline uint32_t gds_group_match(const uint8_t *group, uint8_t h2){
+        uint32_t mask = 0;
+        for (int i = 0; i < GDS_GROUP_WIDTH; i++)
+                mask |= (uint32_t) (group[i] == h2) << i;
+        return mask;
+}
+
+static inline uint32_t gds_group_match_free(const uint8_t *group){
+        uint32_t mask = 0;
+        for (int i = 0; i < GDS_GROUP_WIDTH; i++)
+                mask |= (uint32_t) (group[i] >> 7) << i;
+        return mask;
+}
+
+#endif
+
+/**
+ * Defines a hash map from K to V, specialized at compile time.
+ * Unlike hash_map_t, the keys and values are stored as K and V, and
+ * the hash and the comparison are expressions instead of function
+ * pointers, so the compiler can inline the whole lookup.
+ * The hash isn't stored in the slots. It's computed again when
+ * the table grows, so hash_expr should be cheap.
+ *
+ * @param name prefix of the generated type (name_t) and functions
+ *             (name_init, name_put, name_get...)
+ * @param hash_expr 64 bit hash of a K named key
+ * @param eq_expr true if the Ks named a and b are equal
+ *
+ * Example:
+ *      GDS_DEFINE_HASHMAP(intmap, int, int, gds_mix64(key), a == b)
+ *
+ *      intmap_t *map = intmap_init();
+ *      intmap_put(map, 1, 10);
+ *      int *v = intmap_get_ref(map, 1);
+ *      intmap_free(map);
+ *
+ * The generated functions are static inline, so the macro can be
+ * used in a header. They work like the hashmap_ function of the
+ * same name, but take the keys and values by value.
+ */
+#define GDS_DEFINE_HASHMAP(name, K, V, hash_expr, eq_expr) \
+ \
+typedef struct name##_slot { \
+        K key; \
+        V value; \
+} name##_slot_t; \
+ \
+typedef struct name { \
+        name##_slot_t *slots; \
+        uint8_t *ctrl; \
+        size_t capacity; \
+        size_t n_elements; \
+        size_t n_deleted; \
+        unsigned shift; \
+} name##_t; \
+ \
+typedef struct name##_iterator_t { \
+        const name##_t *map; \
+        size_t pos; \
+} name##_iterator_t; \
+ \
+static inline uint64_t name##__hash(K key){ \
+        return (uint64_t) (hash_expr); \
+} \
+ \
+static inline bool name##__eq(K a, K b){ \
+        return (eq_expr); \
+} \
+ \
+static inline void name##__set_ctrl(name##_t *map, size_t pos, uint8_t c){ \
+        map->ctrl[pos] = c; \
+        if (pos < GDS_GROUP_WIDTH) \
+                map->ctrl[map->capacity + pos] = c; \
+} \
+ \
+static inline int name##__alloc(name##_t *map, size_t capacity){ \
+        name##_slot_t *slots = (name##_slot_t*) malloc(capacity * sizeof(name##_slot_t) + capacity + GDS_GROUP_WIDTH); \
+        if (!slots) \
+                return GDS_NOMEM_ERROR; \
+        map->slots = slots; \
+        map->ctrl = (uint8_t*) (slots + capacity); \
+        map->capacity = capacity; \
+        map->n_elements = 0; \
+        map->n_deleted = 0; \
+        map->shift = 64 - __builtin_ctzll(capacity); \
+        memset(map->ctrl, GDS_CTRL_EMPTY, capacity + GDS_GROUP_WIDTH); \
+        return GDS_SUCCESS; \
+} \
+ \
+/* Position of the key, or -1 */ \
+static inline ptrdiff_t name##__find(const name##_t *map, K key, uint64_t hash){ \
+        uint8_t h2 = gds_ctrl_h2(hash); \
+        size_t mask = map->capacity - 1; \
+        size_t pos = gds_home_pos(hash, map->shift); \
+        for (size_t i = 0; i < map->capacity; i += GDS_GROUP_WIDTH) { \
+                const uint8_t *group = &map->ctrl[pos]; \
+                for (uint32_t match = gds_group_match(group, h2); match; match &= match - 1) { \
+                        size_t p = (pos + __builtin_ctz(match)) & mask; \
+                        if (name##__eq(map->slots[p].key, key)) \
+                                return p; \
+                } \
+                if (gds_group_match(group, GDS_CTRL_EMPTY)) \
+                        return -1; \
+                pos = (pos + GDS_GROUP_WIDTH) & mask; \
+        } \
+        return -1; \
+} \
+ \
+/* First EMPTY or DELETED position in the probe sequence */ \
+static inline size_t name##__find_free(const name##_t *map, uint64_t hash){ \
+        size_t mask = map->capacity - 1; \
+        size_t pos = gds_home_pos(hash, map->shift); \
+        for (;;) { \
+                uint32_t avail = gds_group_match_free(&map->ctrl[pos]); \
+                if (avail) \
+                        return (pos + __builtin_ctz(avail)) & mask; \
+                pos = (pos + GDS_GROUP_WIDTH) & mask; \
+        } \
+} \
+ \
+static inline int name##__rehash(name##_t *map, size_t capacity){ \
+        name##_t old = *map; \
+        if (name##__alloc(map, capacity) != GDS_SUCCESS) { \
+                *map = old; \
+                return GDS_NOMEM_ERROR; \
+        } \
+        for (size_t i = 0; i < old.capacity; i++) { \
+                if (old.ctrl[i] & 0x80) \
+                        continue; \
+                uint64_t hash = name##__hash(old.slots[i].key); \
+                size_t pos = name##__find_free(map, hash); \
+                name##__set_ctrl(map, pos, old.ctrl[i]); \
+                map->slots[pos] = old.slots[i]; \
+        } \
+        map->n_elements = old.n_elements; \
+        free(old.slots); \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline name##_t* name##_init(void){ \
+        name##_t *map = (name##_t*) malloc(sizeof(*map)); \
+        if (!map) \
+                return NULL; \
+        if (name##__alloc(map, GDS_GROUP_WIDTH) != GDS_SUCCESS) { \
+                free(map); \
+                return NULL; \
+        } \
+        return map; \
+} \
+ \
+/* Grows the table so it can hold n elements without rehashing */ \
+static inline int name##_reserve(name##_t *map, size_t n){ \
+        size_t capacity = map->capacity; \
+        while (n * 5 >= capacity * 4) \
+                capacity *= 2; \
+        if (capacity == map->capacity) \
+                return GDS_SUCCESS; \
+        return name##__rehash(map, capacity); \
+} \
+ \
+/* \
+ * Returns a reference to the value of the key, inserting it \
+ * with a zeroed value if it doesn't exist (see hashmap_entry). \
+ */ \
+static inline V* name##_entry(name##_t *map, K key, bool *inserted){ \
+        if (inserted) \
+                *inserted = false; \
+        uint64_t hash = name##__hash(key); \
+        ptrdiff_t found = name##__find(map, key, hash); \
+        if (found >= 0) \
+                return &map->slots[found].value; \
+        size_t pos = name##__find_free(map, hash); \
+        /* Keep the load (including DELETED slots) under 0.8 */ \
+        if (map->ctrl[pos] == GDS_CTRL_EMPTY \
+            && (map->n_elements + map->n_deleted + 1) * 5 > map->capacity * 4) \
+        { \
+                size_t capacity = map->capacity; \
+                if (map->n_deleted < map->n_elements) \
+                        capacity *= 2; \
+                if (name##__rehash(map, capacity) != GDS_SUCCESS) \
+                        return NULL; \
+                pos = name##__find_free(map, hash); \
+        } \
+        if (map->ctrl[pos] == GDS_CTRL_DELETED) \
+                map->n_deleted--; \
+        name##__set_ctrl(map, pos, gds_ctrl_h2(hash)); \
+        map->slots[pos].key = key; \
+        memset(&map->slots[pos].value, 0, sizeof(V)); \
+        map->n_elements++; \
+        if (inserted) \
+                *inserted = true; \
+        return &map->slots[pos].value; \
+} \
+ \
+static inline int name##_put(name##_t *map, K key, V value){ \
+        V *ref = name##_entry(map, key, NULL); \
+        if (!ref) \
+                return GDS_NOMEM_ERROR; \
+        *ref = value; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline V* name##_get_ref(const name##_t *map, K key){ \
+        ptrdiff_t pos = name##__find(map, key, name##__hash(key)); \
+        return pos >= 0 ? &map->slots[pos].value : NULL; \
+} \
+ \
+static inline V* name##_get(const name##_t *map, K key, V *dest){ \
+        V *ref = name##_get_ref(map, key); \
+        if (!ref) \
+                return NULL; \
+        *dest = *ref; \
+        return dest; \
+} \
+ \
+static inline bool name##_exists(const name##_t *map, K key){ \
+        return name##__find(map, key, name##__hash(key)) >= 0; \
+} \
+ \
+static inline int name##_remove(name##_t *map, K key){ \
+        ptrdiff_t pos = name##__find(map, key, name##__hash(key)); \
+        if (pos < 0) \
+                return GDS_ELEMENT_NOT_FOUND_ERROR; \
+        name##__set_ctrl(map, pos, GDS_CTRL_DELETED); \
+        map->n_elements--; \
+        map->n_deleted++; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline size_t name##_length(const name##_t *map){ \
+        return map->n_elements; \
+} \
+ \
+static inline name##_iterator_t name##_iterator(const name##_t *map){ \
+        name##_iterator_t it = { map, 0 }; \
+        return it; \
+} \
+ \
+static inline bool name##_it_next(name##_iterator_t *it, K **key_ref, V **value_ref){ \
+        const name##_t *map = it->map; \
+        while (it->pos < map->capacity) { \
+                size_t pos = it->pos++; \
+                if (map->ctrl[pos] & 0x80) \
+                        continue; \
+                if (key_ref) \
+                        *key_ref = &map->slots[pos].key; \
+                if (value_ref) \
+                        *value_ref = &map->slots[pos].value; \
+                return true; \
+        } \
+        return false; \
+} \
+ \
+static inline void name##_clear(name##_t *map){ \
+        memset(map->ctrl, GDS_CTRL_EMPTY, map->capacity + GDS_GROUP_WIDTH); \
+        map->n_elements = 0; \
+        map->n_deleted = 0; \
+} \
+ \
+static inline void name##_free(name##_t *map){ \
+        if (!map) \
+                return; \
+        free(map->slots); \
+        free(map); \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * typed_heap.h - Type-specialized heaps.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef TYPED_HEAP_H
+#define TYPED_HEAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "typed_vector.h"
+
+/**
+ * Defines a binary min-heap of T, specialized at compile time.
+ * The elements live in a vector generated with GDS_DEFINE_VECTOR,
+ * and are compared with less_expr, inlined, instead of through a
+ * comparator_function_t. Filtering up and down moves a hole instead
+ * of swapping, so every level costs one copy instead of three.
+ *
+ * @param name prefix of the generated type (name_t) and functions
+ *             (name_init, name_add, name_pop_min...)
+ * @param less_expr true if the T named a goes before the T named b
+ *
+ * Example:
+ *      GDS_DEFINE_HEAP(intheap, int, a < b)
+ *
+ *      intheap_t *heap = intheap_init();
+ *      intheap_add(heap, 5);
+ *      int min;
+ *      intheap_pop_min(heap, &min);
+ *      intheap_free(heap);
+ *
+ * The generated functions are static inline, and work
+ * like the heap_ function of the same name.
+ */
+#define GDS_DEFINE_HEAP(name, T, less_expr) \
+ \
+GDS_DEFINE_VECTOR(name##__vec, T) \
+ \
+typedef name##__vec_t name##_t; \
+ \
+static inline bool name##__less(T a, T b){ \
+        return (less_expr); \
+} \
+ \
+static inline void name##__filter_up(name##_t *heap, size_t pos){ \
+        T *items = heap->items; \
+        T element = items[pos]; \
+        while (pos > 0) { \
+                size_t father = (pos - 1) / 2; \
+                if (!name##__less(element, items[father])) \
+                        break; \
+                items[pos] = items[father]; \
+                pos = father; \
+        } \
+        items[pos] = element; \
+} \
+ \
+static inline void name##__filter_down(name##_t *heap, size_t pos){ \
+        T *items = heap->items; \
+        size_t size = heap->n_elements; \
+        T element = items[pos]; \
+        for (;;) { \
+                size_t child = pos * 2 + 1; \
+                if (child >= size) \
+                        break; \
+                if (child + 1 < size && name##__less(items[child + 1], items[child])) \
+                        child++; \
+                if (!name##__less(items[child], element)) \
+                        break; \
+                items[pos] = items[child]; \
+                pos = child; \
+        } \
+        items[pos] = element; \
+} \
+ \
+static inline name##_t* name##_init(void){ \
+        return name##__vec_init(); \
+} \
+ \
+static inline int name##_add(name##_t *heap, T element){ \
+        int status = name##__vec_append(heap, element); \
+        if (status != GDS_SUCCESS) \
+                return status; \
+        name##__filter_up(heap, heap->n_elements - 1); \
+        return GDS_SUCCESS; \
+} \
+ \
+/* \
+ * If the new elements are at least as many as the old ones, \
+ * the whole heap is rebuilt bottom-up, which is linear. \
+ */ \
+static inline int name##_add_array(name##_t *heap, const T *array, size_t array_length){ \
+        size_t old_size = heap->n_elements; \
+        int status = name##__vec_append_array(heap, array, array_length); \
+        if (status != GDS_SUCCESS) \
+                return status; \
+        if (array_length >= old_size) { \
+                for (size_t i = heap->n_elements / 2; i > 0; i--) \
+                        name##__filter_down(heap, i - 1); \
+        } else { \
+                for (size_t i = old_size; i < heap->n_elements; i++) \
+                        name##__filter_up(heap, i); \
+        } \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline T* name##_peek(const name##_t *heap, T *dest){ \
+        return name##__vec_front(heap, dest); \
+} \
+ \
+static inline T* name##_pop_min(name##_t *heap, T *dest){ \
+        if (heap->n_elements == 0) \
+                return NULL; \
+        *dest = heap->items[0]; \
+        heap->items[0] = heap->items[--heap->n_elements]; \
+        if (heap->n_elements > 0) \
+                name##__filter_down(heap, 0); \
+        return dest; \
+} \
+ \
+static inline size_t name##_size(const name##_t *heap){ \
+        return heap->n_elements; \
+} \
+ \
+static inline bool name##_isempty(const name##_t *heap){ \
+        return heap->n_elements == 0; \
+} \
+ \
+static inline void name##_clear(name##_t *heap){ \
+        name##__vec_clear(heap); \
+} \
+ \
+static inline void name##_free(name##_t *heap){ \
+        name##__vec_free(heap); \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
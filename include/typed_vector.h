@@ -0,0 +1,242 @@
+/*
+ * typed_vector.h - Type-specialized vectors.
+ * Author: Saúl Valdelvira (2023)
+ */
+#pragma once
+#ifndef TYPED_VECTOR_H
+#define TYPED_VECTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+
+#define GDS_VECTOR_DEFAULT_SIZE 12
+#define GDS_VECTOR_GROW_FACTOR 2
+
+/**
+ * Defines a vector of T, specialized at compile time.
+ * Unlike vector_t, the elements are stored, passed and returned as T,
+ * so accessing one is a plain array access the compiler can inline
+ * and vectorize, instead of a call and a memcpy of data_size bytes.
+ *
+ * @param name prefix of the generated type (name_t) and functions
+ *             (name_init, name_append, name_at...)
+ *
+ * Example:
+ *      GDS_DEFINE_VECTOR(intvec, int)
+ *
+ *      intvec_t *v = intvec_init();
+ *      intvec_append(v, 1);
+ *      int *first = intvec_at_ref(v, 0);
+ *      intvec_free(v);
+ *
+ * The generated functions are static inline, and work like the vector_
+ * function of the same name. Negative indexes count from the back.
+ * The functions that need to compare elements (vector_indexof,
+ * vector_sort...) are left out, since there's no comparator.
+ * A stack is the vector used through append, back and pop_back.
+ */
+#define GDS_DEFINE_VECTOR(name, T) \
+ \
+typedef struct name { \
+        T *items; \
+        size_t n_elements; \
+        size_t capacity; \
+} name##_t; \
+ \
+static inline name##_t* name##_with_capacity(size_t capacity){ \
+        if (capacity == 0) \
+                capacity = 1; \
+        name##_t *v = (name##_t*) malloc(sizeof(*v)); \
+        if (!v) \
+                return NULL; \
+        v->items = (T*) malloc(capacity * sizeof(T)); \
+        if (!v->items) { \
+                free(v); \
+                return NULL; \
+        } \
+        v->n_elements = 0; \
+        v->capacity = capacity; \
+        return v; \
+} \
+ \
+static inline name##_t* name##_init(void){ \
+        return name##_with_capacity(GDS_VECTOR_DEFAULT_SIZE); \
+} \
+ \
+static inline int name##__resize_buffer(name##_t *v, size_t capacity){ \
+        T *items = (T*) realloc(v->items, capacity * sizeof(T)); \
+        if (!items) \
+                return GDS_ERROR; \
+        v->items = items; \
+        v->capacity = capacity; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline int name##_reserve(name##_t *v, size_t n_elements){ \
+        if (n_elements <= v->capacity) \
+                return GDS_SUCCESS; \
+        return name##__resize_buffer(v, n_elements); \
+} \
+ \
+static inline int name##_shrink(name##_t *v){ \
+        size_t capacity = v->n_elements ? v->n_elements : 1; \
+        return name##__resize_buffer(v, capacity); \
+} \
+ \
+/* Turns a negative index into one from the front, and checks the bounds */ \
+static inline bool name##__index(const name##_t *v, ptrdiff_t *index){ \
+        if (*index < 0) \
+                *index += v->n_elements; \
+        return *index >= 0 && (size_t) *index < v->n_elements; \
+} \
+ \
+static inline int name##_append(name##_t *v, T element){ \
+        if (v->n_elements == v->capacity \
+            && name##__resize_buffer(v, v->capacity * GDS_VECTOR_GROW_FACTOR) != GDS_SUCCESS) \
+                return GDS_ERROR; \
+        v->items[v->n_elements++] = element; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline int name##_insert_at(name##_t *v, ptrdiff_t index, T element){ \
+        if ((size_t) index == v->n_elements) \
+                return name##_append(v, element); \
+        if (!name##__index(v, &index)) \
+                return GDS_INDEX_BOUNDS_ERROR; \
+        if (v->n_elements == v->capacity \
+            && name##__resize_buffer(v, v->capacity * GDS_VECTOR_GROW_FACTOR) != GDS_SUCCESS) \
+                return GDS_ERROR; \
+        memmove(&v->items[index + 1], &v->items[index], (v->n_elements - index) * sizeof(T)); \
+        v->items[index] = element; \
+        v->n_elements++; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline int name##_push_front(name##_t *v, T element){ \
+        return name##_insert_at(v, 0, element); \
+} \
+ \
+static inline int name##_append_array(name##_t *v, const T *array, size_t array_length){ \
+        if (v->capacity - v->n_elements < array_length \
+            && name##__resize_buffer(v, v->capacity + array_length) != GDS_SUCCESS) \
+                return GDS_ERROR; \
+        memcpy(&v->items[v->n_elements], array, array_length * sizeof(T)); \
+        v->n_elements += array_length; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline T* name##_at_ref(const name##_t *v, ptrdiff_t index){ \
+        if (!name##__index(v, &index)) \
+                return NULL; \
+        return &v->items[index]; \
+} \
+ \
+static inline T* name##_at(const name##_t *v, ptrdiff_t index, T *dest){ \
+        T *ref = name##_at_ref(v, index); \
+        if (!ref) \
+                return NULL; \
+        *dest = *ref; \
+        return dest; \
+} \
+ \
+static inline int name##_set_at(name##_t *v, ptrdiff_t index, T replacement){ \
+        if (!name##__index(v, &index)) \
+                return GDS_INDEX_BOUNDS_ERROR; \
+        v->items[index] = replacement; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline T* name##_front_ref(const name##_t *v){ \
+        return name##_at_ref(v, 0); \
+} \
+ \
+static inline T* name##_back_ref(const name##_t *v){ \
+        return name##_at_ref(v, -1); \
+} \
+ \
+static inline T* name##_front(const name##_t *v, T *dest){ \
+        return name##_at(v, 0, dest); \
+} \
+ \
+static inline T* name##_back(const name##_t *v, T *dest){ \
+        return name##_at(v, -1, dest); \
+} \
+ \
+static inline int name##_swap(name##_t *v, ptrdiff_t index_1, ptrdiff_t index_2){ \
+        if (!name##__index(v, &index_1) || !name##__index(v, &index_2)) \
+                return GDS_INDEX_BOUNDS_ERROR; \
+        T tmp = v->items[index_1]; \
+        v->items[index_1] = v->items[index_2]; \
+        v->items[index_2] = tmp; \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline T* name##_pop_at(name##_t *v, ptrdiff_t index, T *dest){ \
+        if (!name##__index(v, &index)) \
+                return NULL; \
+        if (dest) \
+                *dest = v->items[index]; \
+        memmove(&v->items[index], &v->items[index + 1], (v->n_elements - index - 1) * sizeof(T)); \
+        v->n_elements--; \
+        return dest; \
+} \
+ \
+static inline int name##_remove_at(name##_t *v, ptrdiff_t index){ \
+        if (!name##__index(v, &index)) \
+                return GDS_INDEX_BOUNDS_ERROR; \
+        name##_pop_at(v, index, NULL); \
+        return GDS_SUCCESS; \
+} \
+ \
+static inline T* name##_pop_front(name##_t *v, T *dest){ \
+        return name##_pop_at(v, 0, dest); \
+} \
+ \
+static inline T* name##_pop_back(name##_t *v, T *dest){ \
+        if (v->n_elements == 0) \
+                return NULL; \
+        v->n_elements--; \
+        if (dest) \
+                *dest = v->items[v->n_elements]; \
+        return dest; \
+} \
+ \
+static inline T* name##_get_buffer(name##_t *v){ \
+        return v->items; \
+} \
+ \
+static inline size_t name##_size(const name##_t *v){ \
+        return v->n_elements; \
+} \
+ \
+static inline bool name##_isempty(const name##_t *v){ \
+        return v->n_elements == 0; \
+} \
+ \
+static inline size_t name##_capacity(const name##_t *v){ \
+        return v->capacity; \
+} \
+ \
+static inline void name##_clear(name##_t *v){ \
+        v->n_elements = 0; \
+} \
+ \
+static inline void name##_free(name##_t *v){ \
+        if (!v) \
+                return; \
+        free(v->items); \
+        free(v); \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * arena.c - Arena of strings.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "arena.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * The arena is a list of chunks, newest first. The strings
+ * are bumped out of the newest one. A string that doesn't
+ * fit in a chunk of CHUNK_SIZE gets a chunk of its own.
+ *
+ * [ len | chars | \0 | pad ]
+ *
+ * Every entry starts at a multiple of sizeof(size_t),
+ * so the length before the string is aligned.
+ */
+#define CHUNK_SIZE (64 * 1024)
+
+struct chunk {
+        struct chunk *next;
+        size_t used;
+        size_t size;
+        _Alignas(size_t) char data[];
+};
+
+struct arena {
+        struct chunk *head;
+        size_t bytes;
+};
+
+static inline size_t entry_size(size_t len){
+        size_t n = sizeof(size_t) + len + 1;
+        return (n + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+struct arena* arena_init(void){
+        struct arena *arena = gdsmalloc(sizeof(*arena));
+        if (!arena) return NULL;
+        arena->head = NULL;
+        arena->bytes = 0;
+        return arena;
+}
+
+static struct chunk* __new_chunk(struct arena *arena, size_t size){
+        struct chunk *c = gdsmalloc(sizeof(*c) + size);
+        if (!c) return NULL;
+        c->used = 0;
+        c->size = size;
+        c->next = arena->head;
+        arena->head = c;
+        arena->bytes += size;
+        return c;
+}
+
+char* arena_strndup(struct arena *arena, const char *str, size_t len){
+        assert(arena && str);
+        if (len > SIZE_MAX / 2)
+                return NULL;
+        size_t size = entry_size(len);
+        struct chunk *c = arena->head;
+        if (!c || c->size - c->used < size) {
+                c = __new_chunk(arena, size > CHUNK_SIZE ? size : CHUNK_SIZE);
+                if (!c) return NULL;
+        }
+        size_t *entry = (size_t*) &c->data[c->used];
+        c->used += size;
+        *entry = len;
+        char *copy = (char*) (entry + 1);
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+        return copy;
+}
+
+size_t arena_bytes(const struct arena *arena){
+        assert(arena);
+        return arena->bytes;
+}
+
+void arena_clear(struct arena *arena){
+        assert(arena);
+        struct chunk *c = arena->head;
+        if (!c)
+                return;
+        /* Keep the oldest chunk to be reused */
+        while (c->next) {
+                struct chunk *next = c->next;
+                gdsfree(c);
+                c = next;
+        }
+        c->used = 0;
+        arena->head = c;
+        arena->bytes = c->size;
+}
+
+void arena_free(struct arena *arena){
+        if (!arena)
+                return;
+        struct chunk *c = arena->head;
+        while (c) {
+                struct chunk *next = c->next;
+                gdsfree(c);
+                c = next;
+        }
+        gdsfree(arena);
+}
@@ -0,0 +1,46 @@
+/*
+ * arena.h - Arena of strings.
+ * Author: Saúl Valdelvira (2023)
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * Append-only storage for copies of strings.
+ * The strings are packed in big chunks, so copying one is a bump
+ * of a pointer most of the time, and they never move, so pointers
+ * to them stay valid until the arena is cleared or freed.
+ * The length of every string is stored right before it.
+ */
+struct arena;
+
+struct arena* arena_init(void);
+
+/**
+ * Copies the len bytes of str into the arena, followed by a '\0'.
+ * @return the copy, or NULL if there's not enough memory.
+ */
+char* arena_strndup(struct arena *arena, const char *str, size_t len);
+
+/**
+ * Returns the length of a string copied with arena_strndup.
+ */
+static inline size_t arena_strlen(const char *str){
+        return ((const size_t*) str)[-1];
+}
+
+/**
+ * Size (in bytes) of all the chunks of the arena.
+ */
+size_t arena_bytes(const struct arena *arena);
+
+/**
+ * Forgets all the strings. Keeps the first chunk to be reused.
+ */
+void arena_clear(struct arena *arena);
+
+void arena_free(struct arena *arena);
+
+#endif /* __ARENA_H__ */
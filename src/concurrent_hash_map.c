@@ -0,0 +1,241 @@
+/*
+ * concurrent_hash_map.c - Sharded concurrent hash map implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "concurrent_hash_map.h"
+#include "hash_map.h"
+#include "hash_map_priv.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+
+#define CACHE_LINE 64
+
+/*
+ * Every shard is padded to a cache line, so two threads
+ * locking neighbour shards don't fight for the same line.
+ */
+struct shard {
+        union {
+                struct {
+                        pthread_rwlock_t lock;  ///< Protects the map
+                        hash_map_t *map;        ///< Elements of this shard
+                        void *scratch;          ///< Buffer of value_size bytes, for compute_if_absent
+                };
+                char pad[CACHE_LINE * ((sizeof(pthread_rwlock_t) + 2 * sizeof(void*) + CACHE_LINE - 1) / CACHE_LINE)];
+        };
+};
+
+struct concurrent_hash_map {
+        hash_function_t hash;   ///< Hashing function pointer
+        size_t value_size;      ///< Size (in bytes) of the value data type
+        size_t n_shards;        ///< Number of shards. Always a power of two
+        u32 shift;              ///< 64 - log2(n_shards)
+        struct shard shards[];  ///< Shards of the map
+};
+
+/**
+ * Selects the shard for the given hash.
+ * The top bits of the mixed hash are used, since the
+ * shard's hash_map uses the low ones to place the key.
+ * The hash is then passed to the shard's hash_map, so
+ * the key is only hashed once.
+ */
+static struct shard* get_shard(concurrent_hashmap_t *map, hashcode_t hash){
+        if (map->n_shards == 1)
+                return &map->shards[0];
+        hashcode_t h = hash * 0x9E3779B97F4A7C15ULL;
+        return &map->shards[h >> map->shift];
+}
+
+/// INITIALIZE ////////////////////////////////////////////////////////////////
+
+static void __free_shards(concurrent_hashmap_t *map, size_t n){
+        for (size_t i = 0; i < n; i++) {
+                pthread_rwlock_destroy(&map->shards[i].lock);
+                hashmap_free(map->shards[i].map);
+                gdsfree(map->shards[i].scratch);
+        }
+}
+
+concurrent_hashmap_t* concurrent_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t n_shards){
+        assert(hash_func && key_size > 0);
+        if (n_shards == 0)
+                n_shards = CONCURRENT_HASHMAP_DEF_SHARDS;
+        u32 log = 0;
+        while (((size_t)1 << log) < n_shards)
+                log++;
+        n_shards = (size_t)1 << log;
+
+        concurrent_hashmap_t *map = gdsmalloc(sizeof(*map) + n_shards * sizeof(struct shard));
+        if (!map) return NULL;
+        map->hash = hash_func;
+        map->value_size = value_size;
+        map->n_shards = n_shards;
+        map->shift = 64 - log;
+
+        for (size_t i = 0; i < n_shards; i++) {
+                struct shard *s = &map->shards[i];
+                s->map = hashmap_init(key_size, value_size, hash_func, cmp);
+                s->scratch = value_size ? gdsmalloc(value_size) : NULL;
+                if (!s->map || (value_size && !s->scratch)
+                    || pthread_rwlock_init(&s->lock, NULL) != 0)
+                {
+                        hashmap_free(s->map);
+                        gdsfree(s->scratch);
+                        __free_shards(map, i);
+                        gdsfree(map);
+                        return NULL;
+                }
+        }
+        return map;
+}
+
+int concurrent_hashmap_configure(concurrent_hashmap_t *map, enum Redispersion redispersion, double min_lf, double max_lf){
+        assert(map);
+        for (size_t i = 0; i < map->n_shards; i++) {
+                int status = hashmap_configure(map->shards[i].map, redispersion, min_lf, max_lf);
+                if (status != GDS_SUCCESS)
+                        return status;
+        }
+        return GDS_SUCCESS;
+}
+
+void concurrent_hashmap_set_destructor(concurrent_hashmap_t *map, destructor_function_t value_destructor){
+        if (!map)
+                return;
+        for (size_t i = 0; i < map->n_shards; i++)
+                hashmap_set_destructor(map->shards[i].map, value_destructor);
+}
+
+/// OPERATIONS ////////////////////////////////////////////////////////////////
+
+int concurrent_hashmap_put(concurrent_hashmap_t *map, void *key, void *value){
+        assert(map && key);
+        hashcode_t hash = map->hash(key);
+        struct shard *s = get_shard(map, hash);
+        pthread_rwlock_wrlock(&s->lock);
+        int status = hashmap_put_hashed(s->map, key, hash, value);
+        pthread_rwlock_unlock(&s->lock);
+        return status;
+}
+
+void* concurrent_hashmap_get(concurrent_hashmap_t *map, void *key, void *dest){
+        assert(map && key && dest);
+        hashcode_t hash = map->hash(key);
+        struct shard *s = get_shard(map, hash);
+        pthread_rwlock_rdlock(&s->lock);
+        void *ref = hashmap_get_ref_hashed(s->map, key, hash);
+        if (ref)
+                memcpy(dest, ref, map->value_size);
+        pthread_rwlock_unlock(&s->lock);
+        return ref ? dest : NULL;
+}
+
+bool concurrent_hashmap_exists(concurrent_hashmap_t *map, void *key){
+        assert(map && key);
+        hashcode_t hash = map->hash(key);
+        struct shard *s = get_shard(map, hash);
+        pthread_rwlock_rdlock(&s->lock);
+        bool ret = hashmap_get_ref_hashed(s->map, key, hash) != NULL;
+        pthread_rwlock_unlock(&s->lock);
+        return ret;
+}
+
+int concurrent_hashmap_compute_if_absent(concurrent_hashmap_t *map, void *key, void *dest,
+                                         compute_function_t compute, void *ctx, bool *inserted)
+{
+        assert(map && key && compute);
+        if (inserted)
+                *inserted = false;
+        hashcode_t hash = map->hash(key);
+        struct shard *s = get_shard(map, hash);
+
+        /* Most of the times the key will be there already, so
+           try first with a read lock, that doesn't block other readers */
+        if (dest) {
+                pthread_rwlock_rdlock(&s->lock);
+                void *found = hashmap_get_ref_hashed(s->map, key, hash);
+                if (found)
+                        memcpy(dest, found, map->value_size);
+                pthread_rwlock_unlock(&s->lock);
+                if (found)
+                        return GDS_SUCCESS;
+        }
+
+        int status = GDS_SUCCESS;
+        pthread_rwlock_wrlock(&s->lock);
+        /* Another thread may have inserted it in the meantime */
+        void *ref = hashmap_get_ref_hashed(s->map, key, hash);
+        if (ref) {
+                if (dest)
+                        memcpy(dest, ref, map->value_size);
+                goto unlock;
+        }
+        status = compute(key, s->scratch, ctx);
+        if (status != GDS_SUCCESS)
+                goto unlock;
+        status = hashmap_put_hashed(s->map, key, hash, s->scratch);
+        if (status != GDS_SUCCESS)
+                goto unlock;
+        if (dest)
+                memcpy(dest, s->scratch, map->value_size);
+        if (inserted)
+                *inserted = true;
+unlock:
+        pthread_rwlock_unlock(&s->lock);
+        return status;
+}
+
+int concurrent_hashmap_remove(concurrent_hashmap_t *map, void *key){
+        assert(map && key);
+        hashcode_t hash = map->hash(key);
+        struct shard *s = get_shard(map, hash);
+        pthread_rwlock_wrlock(&s->lock);
+        int status = hashmap_remove_hashed(s->map, key, hash);
+        pthread_rwlock_unlock(&s->lock);
+        return status;
+}
+
+size_t concurrent_hashmap_length(concurrent_hashmap_t *map){
+        assert(map);
+        size_t len = 0;
+        for (size_t i = 0; i < map->n_shards; i++) {
+                struct shard *s = &map->shards[i];
+                pthread_rwlock_rdlock(&s->lock);
+                len += hashmap_length(s->map);
+                pthread_rwlock_unlock(&s->lock);
+        }
+        return len;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+void concurrent_hashmap_clear(concurrent_hashmap_t *map){
+        if (!map)
+                return;
+        for (size_t i = 0; i < map->n_shards; i++) {
+                struct shard *s = &map->shards[i];
+                pthread_rwlock_wrlock(&s->lock);
+                hashmap_clear(s->map);
+                pthread_rwlock_unlock(&s->lock);
+        }
+}
+
+void (concurrent_hashmap_free)(concurrent_hashmap_t *map, ...){
+        if (!map)
+                return;
+        va_list arg;
+        va_start(arg, map);
+        do {
+                __free_shards(map, map->n_shards);
+                gdsfree(map);
+                map = va_arg(arg, concurrent_hashmap_t*);
+        } while (map);
+        va_end(arg);
+}
@@ -0,0 +1,417 @@
+/*
+ * cuckoo_hash_map.c - Bucketized cuckoo hash map implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "cuckoo_hash_map.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The table is an array of buckets, each one with BUCKET_SLOTS slots.
+ * Like in hash_map.c, a slot stores the hash of the key, the key and
+ * the value inline:
+ *
+ * [ hash | key | pad | value | pad ]
+ *
+ * Every slot also has a tag byte, kept apart in the tags array. A tag
+ * is 0 if the slot is empty, or some bits of the hash of its key, so
+ * most of the slots can be discarded without reading them.
+ *
+ * A key can only be in two buckets, both derived from its hash (see
+ * bucket1 and bucket2). Since the hash is stored in the slot, we can
+ * always tell the alternative bucket of an element without calling
+ * the hash function.
+ */
+#define BUCKET_SLOTS 4
+#define MIN_BUCKETS 4
+#define MAX_LF 0.95
+/* Maximun number of slots visited when looking for an eviction path */
+#define MAX_BFS_NODES 512
+#define FIB_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+struct cuckoo_hash_map {
+        void *slots;                            ///< Array of slots
+        u8 *tags;                               ///< Tags of the slots
+        size_t n_buckets;                       ///< Number of buckets. Always a power of two
+        hash_function_t hash;                   ///< Hashing function pointer
+        destructor_function_t destructor;       ///< Destructor function pointer
+        comparator_function_t cmp;              ///< Comparator function pointer
+        size_t n_elements;   ///< Number of elements in the map
+        u16 value_size;      ///< Size (in bytes) of the value data type
+        u16 key_size;        ///< Size (in bytes) of the key data type
+        u32 key_offset;      ///< Offset (in bytes) of the key inside a slot
+        u32 value_offset;    ///< Offset (in bytes) of the value inside a slot
+        u32 slot_size;       ///< Size (in bytes) of a slot
+};
+
+#define N_SLOTS(map) ((map)->n_buckets * BUCKET_SLOTS)
+
+/// SLOTS //////////////////////////////////////////////////////////////////////
+
+__inline
+static void* slot_at(const cuckoo_hashmap_t *map, size_t idx){
+        return void_offset(map->slots, idx * map->slot_size);
+}
+
+__inline
+static hashcode_t slot_hash(const cuckoo_hashmap_t *map, size_t idx){
+        return *(hashcode_t*) slot_at(map, idx);
+}
+
+__inline
+static void* slot_key(const cuckoo_hashmap_t *map, size_t idx){
+        return void_offset(slot_at(map, idx), map->key_offset);
+}
+
+__inline
+static void* slot_value(const cuckoo_hashmap_t *map, size_t idx){
+        return void_offset(slot_at(map, idx), map->value_offset);
+}
+
+/**
+ * Returns the 8 bits of the hash stored in the tag of a slot (0 is empty).
+ * The hash is mixed first, like H2 in hash_map.c, so the tag doesn't
+ * depend only on the top bits, which hashes like hash_int leave at 0.
+ */
+_const_fn
+static inline u8 tag_of(hashcode_t hash){
+        u8 tag = (hash * 0xC2B2AE3D27D4EB4FULL) >> 56;
+        return tag ? tag : 1;
+}
+
+__inline
+static size_t bucket1(const cuckoo_hashmap_t *map, hashcode_t hash){
+        return hash & (map->n_buckets - 1);
+}
+
+/**
+ * The second bucket is the first one XOR some other bits of the hash.
+ * The XOR'd value is always odd, so both buckets are never the same.
+ */
+__inline
+static size_t bucket2(const cuckoo_hashmap_t *map, hashcode_t hash){
+        size_t offset = ((hash * FIB_MULTIPLIER) >> 40) | 1;
+        return bucket1(map, hash) ^ (offset & (map->n_buckets - 1));
+}
+
+/**
+ * Returns the bucket in which the element with this hash
+ * could be, other than the given one.
+ */
+__inline
+static size_t alt_bucket(const cuckoo_hashmap_t *map, hashcode_t hash, size_t bucket){
+        size_t b1 = bucket1(map, hash);
+        return bucket == b1 ? bucket2(map, hash) : b1;
+}
+
+static void __set_slot(cuckoo_hashmap_t *map, size_t idx, hashcode_t hash, const void *key, const void *value){
+        *(hashcode_t*) slot_at(map, idx) = hash;
+        memcpy(slot_key(map, idx), key, map->key_size);
+        if (map->value_size)
+                memcpy(slot_value(map, idx), value, map->value_size);
+        map->tags[idx] = tag_of(hash);
+}
+
+static void __move_slot(cuckoo_hashmap_t *map, size_t to, size_t from){
+        memcpy(slot_at(map, to), slot_at(map, from), map->slot_size);
+        map->tags[to] = map->tags[from];
+        map->tags[from] = 0;
+}
+
+/// INITIALIZE /////////////////////////////////////////////////////////////////
+
+static int __alloc_table(cuckoo_hashmap_t *map, size_t n_buckets){
+        size_t n_slots = n_buckets * BUCKET_SLOTS;
+        size_t slots_size = n_slots * map->slot_size;
+        void *mem = gdsmalloc(slots_size + n_slots);
+        if (!mem)
+                return GDS_ERROR;
+        map->slots = mem;
+        map->tags = void_offset(mem, slots_size);
+        map->n_buckets = n_buckets;
+        memset(map->tags, 0, n_slots);
+        return GDS_SUCCESS;
+}
+
+cuckoo_hashmap_t* cuckoo_hashmap_with_capacity(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity){
+        assert(hash_func && cmp && key_size > 0);
+        cuckoo_hashmap_t *map = gdsmalloc(sizeof(*map));
+        if (!map) return NULL;
+        map->key_size = key_size;
+        map->value_size = value_size;
+        map->hash = hash_func;
+        map->cmp = cmp;
+        map->destructor = NULL;
+        map->n_elements = 0;
+
+        size_t key_align = align_of_size(key_size);
+        size_t value_align = align_of_size(value_size);
+        size_t slot_align = _Alignof(hashcode_t);
+        if (key_align > slot_align)
+                slot_align = key_align;
+        if (value_align > slot_align)
+                slot_align = value_align;
+        map->key_offset = align_up(sizeof(hashcode_t), key_align);
+        map->value_offset = align_up(map->key_offset + key_size, value_align);
+        map->slot_size = align_up(map->value_offset + value_size, slot_align);
+
+        size_t n_buckets = MIN_BUCKETS;
+        while (n_buckets * BUCKET_SLOTS * MAX_LF < capacity)
+                n_buckets *= 2;
+        if (__alloc_table(map, n_buckets) != GDS_SUCCESS) {
+                gdsfree(map);
+                return NULL;
+        }
+        return map;
+}
+
+cuckoo_hashmap_t* cuckoo_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp){
+        return cuckoo_hashmap_with_capacity(key_size, value_size, hash_func, cmp, 0);
+}
+
+void cuckoo_hashmap_set_destructor(cuckoo_hashmap_t *map, destructor_function_t value_destructor){
+        if (map)
+                map->destructor = value_destructor;
+}
+
+/// FIND ///////////////////////////////////////////////////////////////////////
+
+/**
+ * Looks for the key in its two buckets.
+ * @return the index of its slot, or -1 if it isn't in the map.
+ */
+static ptrdiff_t __find(const cuckoo_hashmap_t *map, const void *key, hashcode_t hash){
+        u8 tag = tag_of(hash);
+        size_t buckets[2] = { bucket1(map, hash), bucket2(map, hash) };
+        for (int b = 0; b < 2; b++) {
+                size_t idx = buckets[b] * BUCKET_SLOTS;
+                for (size_t i = idx; i < idx + BUCKET_SLOTS; i++) {
+                        if (map->tags[i] == tag && slot_hash(map, i) == hash
+                            && map->cmp(key, slot_key(map, i)) == 0)
+                                return i;
+                }
+        }
+        return -1;
+}
+
+static ptrdiff_t __free_slot(const cuckoo_hashmap_t *map, size_t bucket){
+        size_t idx = bucket * BUCKET_SLOTS;
+        for (size_t i = idx; i < idx + BUCKET_SLOTS; i++) {
+                if (map->tags[i] == 0)
+                        return i;
+        }
+        return -1;
+}
+
+/// INSERT /////////////////////////////////////////////////////////////////////
+
+/*
+ * When both buckets of a key are full, we look for an eviction path
+ * with a breadth first search: a chain of elements, each of which can
+ * move to its alternative bucket, ending in one that has a free slot.
+ * BFS finds the shortest path, so the fewest elements are moved.
+ * The elements are moved starting from the end of the path, so every
+ * slot is free by the time the previous element moves into it.
+ */
+
+struct bfs_node {
+        size_t bucket;          ///< Bucket of the element
+        u8 slot;                ///< Slot of the element in its bucket
+        int parent;             ///< Node that wants to move into this slot, or -1
+};
+
+/**
+ * Checks if the bucket is already in the path that leads to the node.
+ * Visiting a bucket twice could make an element move twice.
+ */
+static bool on_path(const struct bfs_node *queue, int node, size_t bucket){
+        for (; node >= 0; node = queue[node].parent) {
+                if (queue[node].bucket == bucket)
+                        return true;
+        }
+        return false;
+}
+
+/**
+ * Inserts the key, that we know is not in the map.
+ * @return the index of its slot, or -1 if there's no room for it.
+ */
+static ptrdiff_t __insert(cuckoo_hashmap_t *map, hashcode_t hash, const void *key, const void *value){
+        size_t b1 = bucket1(map, hash), b2 = bucket2(map, hash);
+        ptrdiff_t idx = __free_slot(map, b1);
+        if (idx < 0)
+                idx = __free_slot(map, b2);
+        if (idx >= 0) {
+                __set_slot(map, idx, hash, key, value);
+                return idx;
+        }
+
+        struct bfs_node queue[MAX_BFS_NODES];
+        int head = 0, tail = 0;
+        for (u8 i = 0; i < BUCKET_SLOTS; i++) {
+                queue[tail++] = (struct bfs_node) { b1, i, -1 };
+                queue[tail++] = (struct bfs_node) { b2, i, -1 };
+        }
+
+        for (; head < tail; head++) {
+                size_t from = queue[head].bucket * BUCKET_SLOTS + queue[head].slot;
+                size_t alt = alt_bucket(map, slot_hash(map, from), queue[head].bucket);
+                if (on_path(queue, head, alt))
+                        continue;
+                ptrdiff_t free = __free_slot(map, alt);
+                if (free >= 0) {
+                        size_t dst = free;
+                        for (int n = head; n >= 0; n = queue[n].parent) {
+                                size_t src = queue[n].bucket * BUCKET_SLOTS + queue[n].slot;
+                                __move_slot(map, dst, src);
+                                dst = src;
+                        }
+                        __set_slot(map, dst, hash, key, value);
+                        return dst;
+                }
+                if (tail + BUCKET_SLOTS > MAX_BFS_NODES)
+                        continue;
+                for (u8 i = 0; i < BUCKET_SLOTS; i++)
+                        queue[tail++] = (struct bfs_node) { alt, i, head };
+        }
+        return -1;
+}
+
+/**
+ * Doubles the number of buckets, and puts the elements
+ * again, using the hash stored in their slots.
+ */
+static int __grow(cuckoo_hashmap_t *map){
+        cuckoo_hashmap_t d = *map;
+        size_t n_buckets = map->n_buckets * 2;
+        for (;;) {
+                if (n_buckets > SIZE_MAX / BUCKET_SLOTS / map->slot_size)
+                        return GDS_NOMEM_ERROR;
+                if (__alloc_table(&d, n_buckets) != GDS_SUCCESS)
+                        return GDS_ERROR;
+                size_t i;
+                for (i = 0; i < N_SLOTS(map); i++) {
+                        if (map->tags[i] == 0)
+                                continue;
+                        if (__insert(&d, slot_hash(map, i), slot_key(map, i), slot_value(map, i)) < 0)
+                                break;
+                }
+                if (i == N_SLOTS(map))
+                        break;
+                /* Very unlikely. Try with an even bigger table */
+                gdsfree(d.slots);
+                n_buckets *= 2;
+        }
+        gdsfree(map->slots);
+        *map = d;
+        return GDS_SUCCESS;
+}
+
+int cuckoo_hashmap_put(cuckoo_hashmap_t *map, void *key, void *value){
+        assert(map && key);
+        if (map->value_size != 0)
+                assert(value);
+        hashcode_t hash = map->hash(key);
+        ptrdiff_t idx = __find(map, key, hash);
+        if (idx >= 0) {
+                void *dst = slot_value(map, idx);
+                if (map->destructor)
+                        map->destructor(dst);
+                if (map->value_size)
+                        memcpy(dst, value, map->value_size);
+                return GDS_SUCCESS;
+        }
+
+        if (map->n_elements + 1 > N_SLOTS(map) * MAX_LF) {
+                int status = __grow(map);
+                if (status != GDS_SUCCESS)
+                        return status;
+        }
+        while (__insert(map, hash, key, value) < 0) {
+                /* No eviction path. Grow the table and try again. */
+                int status = __grow(map);
+                if (status != GDS_SUCCESS)
+                        return status;
+        }
+        map->n_elements++;
+        return GDS_SUCCESS;
+}
+
+/// GET_EXISTS ///////////////////////////////////////////////////////////////
+
+void* cuckoo_hashmap_get_ref(const cuckoo_hashmap_t *map, void *key){
+        assert(map && key);
+        ptrdiff_t idx = __find(map, key, map->hash(key));
+        return idx >= 0 ? slot_value(map, idx) : NULL;
+}
+
+void* cuckoo_hashmap_get(const cuckoo_hashmap_t *map, void *key, void *dest){
+        assert(map && key && dest);
+        void *ref = cuckoo_hashmap_get_ref(map, key);
+        if (!ref)
+                return NULL;
+        return memcpy(dest, ref, map->value_size);
+}
+
+bool cuckoo_hashmap_exists(const cuckoo_hashmap_t *map, void *key){
+        assert(map && key);
+        return __find(map, key, map->hash(key)) >= 0;
+}
+
+size_t cuckoo_hashmap_length(const cuckoo_hashmap_t *map){
+        assert(map);
+        return map->n_elements;
+}
+
+/// REMOVE ////////////////////////////////////////////////////////////////////
+
+int cuckoo_hashmap_remove(cuckoo_hashmap_t *map, void *key){
+        assert(map && key);
+        ptrdiff_t idx = __find(map, key, map->hash(key));
+        if (idx < 0)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        if (map->destructor)
+                map->destructor(slot_value(map, idx));
+        map->tags[idx] = 0;
+        map->n_elements--;
+        return GDS_SUCCESS;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+static void destroy_content(cuckoo_hashmap_t *map){
+        if (!map->destructor)
+                return;
+        for (size_t i = 0; i < N_SLOTS(map); i++) {
+                if (map->tags[i])
+                        map->destructor(slot_value(map, i));
+        }
+}
+
+void cuckoo_hashmap_clear(cuckoo_hashmap_t *map){
+        if (!map)
+                return;
+        destroy_content(map);
+        memset(map->tags, 0, N_SLOTS(map));
+        map->n_elements = 0;
+}
+
+void (cuckoo_hashmap_free)(cuckoo_hashmap_t *map, ...){
+        if (!map)
+                return;
+        va_list arg;
+        va_start(arg, map);
+        do {
+                destroy_content(map);
+                gdsfree(map->slots);
+                gdsfree(map);
+                map = va_arg(arg, cuckoo_hashmap_t*);
+        } while (map);
+        va_end(arg);
+}
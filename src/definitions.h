@@ -11,9 +11,11 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 #include <attrs.h>
 
 typedef int8_t byte;
+typedef uint64_t u64;
 typedef uint32_t u32;
 typedef uint16_t u16;
 typedef uint8_t u8;
@@ -32,6 +34,29 @@ typedef int16_t i16;
         memcpy(e, ptr, size); \
 }
 
+/**
+ * Returns the alignment needed by a type of the given size.
+ * The alignment of a type always divides its size, so the
+ * lowest set bit of the size is a safe choice.
+ */
+_const_fn
+static inline size_t align_of_size(size_t size){
+        size_t align = size & -size;
+        if (align == 0)
+                return 1;
+        if (align > _Alignof(max_align_t))
+                return _Alignof(max_align_t);
+        return align;
+}
+
+/**
+ * Rounds n up to a multiple of align, which must be a power of two.
+ */
+_const_fn
+static inline size_t align_up(size_t n, size_t align){
+        return (n + align - 1) & ~(align - 1);
+}
+
 #define unlikely(expr) __builtin_expect(!!(expr), 0)
 #define likely(expr) __builtin_expect(!!(expr), 1)
 
@@ -11,6 +11,8 @@ const char* gds_get_error_msg(int error_code) {
                         return "Repeated element";
                 case GDS_INVALID_PARAMETER_ERROR:
                         return "Invalid parameter";
+                case GDS_READ_ONLY_ERROR:
+                        return "Read only structure";
                 default:
                         return "Unknown error code";
         }
@@ -0,0 +1,396 @@
+/*
+ * frozen_hash_map.c - Frozen (minimal perfect hash) map implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "frozen_hash_map.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The perfect hash function follows the PTHash scheme.
+ *
+ * The hash of a key is mixed with a seed (x), and x chooses one of
+ * n_buckets buckets, with BUCKET_LOAD keys each on average. Every bucket
+ * has a pilot: a small number that, mixed with x, chooses the position
+ * of the key. The pilots are found when building the map, trying them
+ * one after the other until all the keys of the bucket get free positions.
+ * The biggest buckets go first, while there's still plenty of room.
+ *
+ * Finding positions for the last keys is easier if there are a few more
+ * positions than keys (n / TABLE_LOAD). To keep the function minimal, the
+ * keys that get a position past n are moved to the positions below n
+ * that were left free, using the remap array. Only a lookup that lands
+ * on the last ~1% of positions has to read it.
+ *
+ * The entries are stored in a dense array, in the position of their key:
+ *
+ * [ key | pad | value | pad ]
+ */
+#define BUCKET_LOAD 4
+#define TABLE_LOAD 0.99
+#define MAX_PILOT UINT16_MAX
+#define MAX_SEEDS 32
+#define FIB_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+struct frozen_hash_map {
+        void *entries;                  ///< Array of n_elements entries
+        u16 *pilots;                    ///< Pilot of every bucket
+        size_t *remap;                  ///< Final position of the keys placed at [n_elements, n_positions)
+        hash_function_t hash;           ///< Hashing function pointer
+        comparator_function_t cmp;      ///< Comparator function pointer
+        hashcode_t seed;                ///< Seed mixed with the hashes
+        size_t n_elements;      ///< Number of elements in the map
+        size_t n_buckets;       ///< Number of buckets
+        size_t n_positions;     ///< Number of positions of the perfect hash function (>= n_elements)
+        u16 key_size;           ///< Size (in bytes) of the key data type
+        u16 value_size;         ///< Size (in bytes) of the value data type
+        u32 value_offset;       ///< Offset (in bytes) of the value inside an entry
+        u32 entry_size;         ///< Size (in bytes) of an entry
+};
+
+/// HASHING ////////////////////////////////////////////////////////////////////
+
+/**
+ * splitmix64 finalizer.
+ * see: <https://prng.di.unimi.it/splitmix64.c>
+ */
+_const_fn
+static inline hashcode_t mix64(hashcode_t x){
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+}
+
+/**
+ * Maps x to [0, range) with a multiplication instead of a
+ * division, using its highest bits.
+ */
+_const_fn
+static inline size_t reduce(hashcode_t x, size_t range){
+        if (range <= UINT32_MAX)
+                return ((x >> 32) * range) >> 32;
+        return x % range;
+}
+
+__inline
+static size_t bucket_of(const frozen_hashmap_t *map, hashcode_t x){
+        return reduce(x, map->n_buckets);
+}
+
+__inline
+static size_t position_of(const frozen_hashmap_t *map, hashcode_t x, u16 pilot){
+        return reduce(mix64(x + pilot * FIB_MULTIPLIER), map->n_positions);
+}
+
+/// ENTRIES ////////////////////////////////////////////////////////////////////
+
+__inline
+static void* entry_at(const frozen_hashmap_t *map, size_t pos){
+        return void_offset(map->entries, pos * map->entry_size);
+}
+
+/// BUILD //////////////////////////////////////////////////////////////////////
+
+/*
+ * Scratch memory used while building the map.
+ */
+struct builder {
+        hashcode_t *hashes;     ///< Hash of every key
+        hashcode_t *xs;         ///< Hash of every key, mixed with the current seed
+        size_t *order;          ///< Keys sorted by bucket
+        size_t *bucket_start;   ///< Start of every bucket in order (n_buckets + 1)
+        size_t *buckets;        ///< Buckets sorted by size, biggest first
+        size_t *key_at;         ///< Key placed in every position
+        u64 *taken;             ///< Bitmap of the positions taken
+        size_t *positions;      ///< Positions of the keys of the current bucket
+};
+
+static void __free_builder(struct builder *b){
+        gdsfree(b->hashes);
+        gdsfree(b->xs);
+        gdsfree(b->order);
+        gdsfree(b->bucket_start);
+        gdsfree(b->buckets);
+        gdsfree(b->key_at);
+        gdsfree(b->taken);
+        gdsfree(b->positions);
+}
+
+static int __alloc_builder(struct builder *b, const frozen_hashmap_t *map){
+        size_t n = map->n_elements;
+        size_t words = (map->n_positions + 63) / 64;
+        *b = (struct builder) {
+                .hashes = gdsmalloc(n * sizeof(hashcode_t)),
+                .xs = gdsmalloc(n * sizeof(hashcode_t)),
+                .order = gdsmalloc(n * sizeof(size_t)),
+                .bucket_start = gdsmalloc((map->n_buckets + 1) * sizeof(size_t)),
+                .buckets = gdsmalloc(map->n_buckets * sizeof(size_t)),
+                .key_at = gdsmalloc(map->n_positions * sizeof(size_t)),
+                .taken = gdsmalloc(words * sizeof(u64)),
+                /* Also used to sort the buckets by size, up to n */
+                .positions = gdsmalloc((n + 2) * sizeof(size_t)),
+        };
+        if (!b->hashes || !b->xs || !b->order || !b->bucket_start || !b->buckets
+            || !b->key_at || !b->taken || !b->positions)
+        {
+                __free_builder(b);
+                return GDS_ERROR;
+        }
+        return GDS_SUCCESS;
+}
+
+__inline
+static bool is_taken(const u64 *taken, size_t pos){
+        return taken[pos / 64] >> (pos % 64) & 1;
+}
+
+__inline
+static void flip_taken(u64 *taken, size_t pos){
+        taken[pos / 64] ^= (u64) 1 << (pos % 64);
+}
+
+/**
+ * Groups the keys by bucket, and sorts the buckets by size.
+ * If two keys have the same hash, no pilot can separate them.
+ * @return GDS_SUCCESS, GDS_REPEATED_ELEMENT_ERROR if a key is repeated,
+ *         or GDS_INVALID_PARAMETER_ERROR if two keys have the same hash.
+ */
+static int __sort_buckets(const frozen_hashmap_t *map, struct builder *b, const void *keys){
+        size_t n = map->n_elements, m = map->n_buckets;
+        memset(b->bucket_start, 0, (m + 1) * sizeof(size_t));
+        for (size_t i = 0; i < n; i++)
+                b->bucket_start[bucket_of(map, b->xs[i]) + 1]++;
+        size_t max_size = 0;
+        for (size_t i = 0; i < m; i++) {
+                if (b->bucket_start[i + 1] > max_size)
+                        max_size = b->bucket_start[i + 1];
+                b->bucket_start[i + 1] += b->bucket_start[i];
+        }
+        /* key_at is free until the pilots are searched */
+        size_t *fill = b->key_at;
+        memcpy(fill, b->bucket_start, m * sizeof(size_t));
+        for (size_t i = 0; i < n; i++)
+                b->order[fill[bucket_of(map, b->xs[i])]++] = i;
+
+        for (size_t i = 0; i < m; i++) {
+                for (size_t j = b->bucket_start[i]; j < b->bucket_start[i + 1]; j++) {
+                        for (size_t k = j + 1; k < b->bucket_start[i + 1]; k++) {
+                                size_t k1 = b->order[j], k2 = b->order[k];
+                                if (b->hashes[k1] != b->hashes[k2])
+                                        continue;
+                                if (map->cmp(void_offset(keys, k1 * map->key_size), void_offset(keys, k2 * map->key_size)) == 0)
+                                        return GDS_REPEATED_ELEMENT_ERROR;
+                                return GDS_INVALID_PARAMETER_ERROR;
+                        }
+                }
+        }
+
+        /* Counting sort of the buckets, by decreasing size */
+        size_t *count = b->positions;
+        memset(count, 0, (max_size + 2) * sizeof(size_t));
+        for (size_t i = 0; i < m; i++)
+                count[max_size - (b->bucket_start[i + 1] - b->bucket_start[i]) + 1]++;
+        for (size_t s = 0; s <= max_size; s++)
+                count[s + 1] += count[s];
+        for (size_t i = 0; i < m; i++)
+                b->buckets[count[max_size - (b->bucket_start[i + 1] - b->bucket_start[i])]++] = i;
+        return GDS_SUCCESS;
+}
+
+/**
+ * Finds the pilot of every bucket, with the current seed.
+ * @return false if some bucket has no valid pilot.
+ */
+static bool __search_pilots(frozen_hashmap_t *map, struct builder *b){
+        memset(b->taken, 0, (map->n_positions + 63) / 64 * sizeof(u64));
+        for (size_t i = 0; i < map->n_buckets; i++) {
+                size_t bucket = b->buckets[i];
+                size_t start = b->bucket_start[bucket];
+                size_t size = b->bucket_start[bucket + 1] - start;
+                if (size == 0) {
+                        /* The rest of the buckets are empty too */
+                        for (; i < map->n_buckets; i++)
+                                map->pilots[b->buckets[i]] = 0;
+                        return true;
+                }
+                u32 pilot;
+                for (pilot = 0; pilot <= MAX_PILOT; pilot++) {
+                        size_t j;
+                        for (j = 0; j < size; j++) {
+                                size_t pos = position_of(map, b->xs[b->order[start + j]], pilot);
+                                if (is_taken(b->taken, pos))
+                                        break;
+                                flip_taken(b->taken, pos);
+                                b->positions[j] = pos;
+                        }
+                        if (j == size)
+                                break;
+                        while (j-- > 0)
+                                flip_taken(b->taken, b->positions[j]);
+                }
+                if (pilot > MAX_PILOT)
+                        return false;
+                map->pilots[bucket] = pilot;
+                for (size_t j = 0; j < size; j++)
+                        b->key_at[b->positions[j]] = b->order[start + j];
+        }
+        return true;
+}
+
+/**
+ * Moves the entries to their final positions, and
+ * fills the remap array for the positions past n.
+ */
+static void __place_entries(frozen_hashmap_t *map, struct builder *b, const void *keys, const void *values){
+        size_t n = map->n_elements;
+        size_t free_pos = 0;
+        for (size_t pos = 0; pos < map->n_positions; pos++) {
+                if (!is_taken(b->taken, pos))
+                        continue;
+                size_t dst = pos;
+                if (pos >= n) {
+                        while (is_taken(b->taken, free_pos))
+                                free_pos++;
+                        dst = free_pos++;
+                        map->remap[pos - n] = dst;
+                }
+                size_t key = b->key_at[pos];
+                void *entry = entry_at(map, dst);
+                memcpy(entry, void_offset(keys, key * map->key_size), map->key_size);
+                if (map->value_size)
+                        memcpy(void_offset(entry, map->value_offset), void_offset(values, key * map->value_size), map->value_size);
+        }
+}
+
+static int __build(frozen_hashmap_t *map, const void *keys, const void *values){
+        struct builder b;
+        if (__alloc_builder(&b, map) != GDS_SUCCESS)
+                return GDS_ERROR;
+        for (size_t i = 0; i < map->n_elements; i++)
+                b.hashes[i] = map->hash(void_offset(keys, i * map->key_size));
+
+        int status = GDS_ERROR;
+        for (int attempt = 0; attempt < MAX_SEEDS; attempt++) {
+                map->seed = mix64(attempt + 1);
+                for (size_t i = 0; i < map->n_elements; i++)
+                        b.xs[i] = mix64(b.hashes[i] ^ map->seed);
+                status = __sort_buckets(map, &b, keys);
+                if (status != GDS_SUCCESS)
+                        break;
+                if (__search_pilots(map, &b)) {
+                        __place_entries(map, &b, keys, values);
+                        break;
+                }
+                status = GDS_ERROR;
+        }
+        __free_builder(&b);
+        return status;
+}
+
+/// INITIALIZE /////////////////////////////////////////////////////////////////
+
+frozen_hashmap_t* frozen_hashmap_from_arrays(const void *keys, const void *values, size_t n, size_t key_size, size_t value_size,
+                                             hash_function_t hash_func, comparator_function_t cmp)
+{
+        assert(keys && hash_func && cmp && key_size > 0);
+        if (value_size != 0)
+                assert(values);
+        frozen_hashmap_t *map = gdsmalloc(sizeof(*map));
+        if (!map) return NULL;
+        map->hash = hash_func;
+        map->cmp = cmp;
+        map->key_size = key_size;
+        map->value_size = value_size;
+        map->n_elements = n;
+        map->n_buckets = n / BUCKET_LOAD + 1;
+        map->n_positions = n / TABLE_LOAD + 1;
+        map->seed = 0;
+
+        size_t key_align = align_of_size(key_size);
+        size_t value_align = align_of_size(value_size);
+        size_t entry_align = key_align > value_align ? key_align : value_align;
+        map->value_offset = align_up(key_size, value_align);
+        map->entry_size = align_up(map->value_offset + value_size, entry_align);
+
+        map->entries = gdsmalloc(n * map->entry_size + 1);
+        map->pilots = gdsmalloc(map->n_buckets * sizeof(u16));
+        map->remap = gdscalloc(map->n_positions - n, sizeof(size_t));
+        if (!map->entries || !map->pilots || !map->remap
+            || (n > 0 && __build(map, keys, values) != GDS_SUCCESS))
+        {
+                gdsfree(map->entries);
+                gdsfree(map->pilots);
+                gdsfree(map->remap);
+                gdsfree(map);
+                return NULL;
+        }
+        return map;
+}
+
+/// GET_EXISTS /////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the entry of the key, or NULL.
+ * Every key goes to a position, even if it's not in the map,
+ * so the key of that position must be compared.
+ */
+static void* __find(const frozen_hashmap_t *map, const void *key){
+        if (map->n_elements == 0)
+                return NULL;
+        hashcode_t x = mix64(map->hash(key) ^ map->seed);
+        size_t pos = position_of(map, x, map->pilots[bucket_of(map, x)]);
+        if (pos >= map->n_elements)
+                pos = map->remap[pos - map->n_elements];
+        void *entry = entry_at(map, pos);
+        return map->cmp(key, entry) == 0 ? entry : NULL;
+}
+
+const void* frozen_hashmap_get_ref(const frozen_hashmap_t *map, const void *key){
+        assert(map && key);
+        void *entry = __find(map, key);
+        return entry ? void_offset(entry, map->value_offset) : NULL;
+}
+
+void* frozen_hashmap_get(const frozen_hashmap_t *map, const void *key, void *dest){
+        assert(map && key && dest);
+        const void *ref = frozen_hashmap_get_ref(map, key);
+        if (!ref)
+                return NULL;
+        return memcpy(dest, ref, map->value_size);
+}
+
+bool frozen_hashmap_exists(const frozen_hashmap_t *map, const void *key){
+        assert(map && key);
+        return __find(map, key) != NULL;
+}
+
+size_t frozen_hashmap_length(const frozen_hashmap_t *map){
+        assert(map);
+        return map->n_elements;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+void (frozen_hashmap_free)(frozen_hashmap_t *map, ...){
+        if (!map)
+                return;
+        va_list arg;
+        va_start(arg, map);
+        do {
+                gdsfree(map->entries);
+                gdsfree(map->pilots);
+                gdsfree(map->remap);
+                gdsfree(map);
+                map = va_arg(arg, frozen_hashmap_t*);
+        } while (map);
+        va_end(arg);
+}
@@ -3,8 +3,12 @@
  * Author: Saúl Valdelvira (2023)
  */
 #include "hash.h"
+#include "definitions.h"
 #include <stdint.h>
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <stdatomic.h>
 
 hashcode_t hash_int(const void *arg){
         return (hashcode_t) * (int*) arg;
@@ -45,3 +49,171 @@ hashcode_t hash_ptr(const void *arg) {
 hashcode_t hash_combine(hashcode_t h1, hashcode_t h2) {
         return h1 ^ (h2 + 0x9e3779b9U + (h1 << 6) + (h1 >> 2));
 }
+
+/// SEED //////////////////////////////////////////////////////////////////////
+
+static _Atomic hashcode_t global_seed = 0;
+
+/**
+ * splitmix64 finalizer.
+ * see: <https://prng.di.unimi.it/splitmix64.c>
+ */
+static inline hashcode_t mix64(hashcode_t x){
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+}
+
+/**
+ * Gets a random seed from /dev/urandom. If it's not available,
+ * the time and the addresses of some variables (randomized by
+ * ASLR) are used instead.
+ */
+static hashcode_t random_seed(void){
+        hashcode_t seed = 0;
+        FILE *f = fopen("/dev/urandom", "rb");
+        if (f) {
+                if (fread(&seed, sizeof(seed), 1, f) != 1)
+                        seed = 0;
+                fclose(f);
+        }
+        if (seed == 0) {
+                int local;
+                seed = mix64((hashcode_t) time(NULL)) ^ mix64((hashcode_t) clock());
+                seed ^= mix64((hashcode_t) (uintptr_t) &local) ^ mix64((hashcode_t) (uintptr_t) &global_seed);
+        }
+        /* 0 means "not initialized" */
+        return seed ? seed : 1;
+}
+
+hashcode_t hash_seed(void){
+        hashcode_t seed = atomic_load_explicit(&global_seed, memory_order_relaxed);
+        if (unlikely(seed == 0)) {
+                hashcode_t expected = 0;
+                seed = random_seed();
+                /* If another thread set it first, use that one */
+                if (!atomic_compare_exchange_strong(&global_seed, &expected, seed))
+                        seed = expected;
+        }
+        return seed;
+}
+
+void hash_set_seed(hashcode_t seed){
+        atomic_store(&global_seed, seed ? seed : 1);
+}
+
+/// WYHASH ////////////////////////////////////////////////////////////////////
+
+/*
+ * Implementation of wyhash (final version 4), by Wang Yi.
+ * see: <https://github.com/wangyi-fudan/wyhash>
+ */
+
+static const hashcode_t WYP[4] = {
+        0xA0761D6478BD642FULL, 0xE7037ED1A0B428DBULL,
+        0x8EBC6AF09C88C6E3ULL, 0x589965CC75374CC3ULL,
+};
+
+/**
+ * 64x64->128 bit multiplication. Leaves the low
+ * half of the result in a, and the high half in b.
+ */
+static inline void mum(uint64_t *a, uint64_t *b){
+#ifdef __SIZEOF_INT128__
+        __extension__ typedef unsigned __int128 u128;
+        u128 r = (u128) *a * *b;
+        *a = (uint64_t) r;
+        *b = (uint64_t) (r >> 64);
+#else
+        uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32), c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+        *a = lo;
+        *b = hi;
+#endif
+}
+
+static inline uint64_t wymix(uint64_t a, uint64_t b){
+        mum(&a, &b);
+        return a ^ b;
+}
+
+static inline uint64_t wyr8(const uint8_t *p){
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+}
+
+static inline uint64_t wyr4(const uint8_t *p){
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+}
+
+static inline uint64_t wyr3(const uint8_t *p, size_t k){
+        return ((uint64_t) p[0] << 16) | ((uint64_t) p[k >> 1] << 8) | p[k - 1];
+}
+
+hashcode_t hash_bytes(const void *ptr, size_t len, hashcode_t seed){
+        const uint8_t *p = ptr;
+        uint64_t a, b;
+        seed ^= wymix(seed ^ WYP[0], WYP[1]);
+        if (likely(len <= 16)) {
+                if (likely(len >= 4)) {
+                        a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+                        b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+                } else if (likely(len > 0)) {
+                        a = wyr3(p, len);
+                        b = 0;
+                } else {
+                        a = b = 0;
+                }
+        } else {
+                size_t i = len;
+                if (unlikely(i > 48)) {
+                        uint64_t see1 = seed, see2 = seed;
+                        do {
+                                seed = wymix(wyr8(p) ^ WYP[1], wyr8(p + 8) ^ seed);
+                                see1 = wymix(wyr8(p + 16) ^ WYP[2], wyr8(p + 24) ^ see1);
+                                see2 = wymix(wyr8(p + 32) ^ WYP[3], wyr8(p + 40) ^ see2);
+                                p += 48;
+                                i -= 48;
+                        } while (likely(i > 48));
+                        seed ^= see1 ^ see2;
+                }
+                while (unlikely(i > 16)) {
+                        seed = wymix(wyr8(p) ^ WYP[1], wyr8(p + 8) ^ seed);
+                        i -= 16;
+                        p += 16;
+                }
+                a = wyr8(p + i - 16);
+                b = wyr8(p + i - 8);
+        }
+        a ^= WYP[1];
+        b ^= seed;
+        mum(&a, &b);
+        return wymix(a ^ WYP[0] ^ len, b ^ WYP[1]);
+}
+
+hashcode_t hash_string_fast(const void *arg){
+        const char *str = * (char**) arg;
+        return hash_bytes(str, strlen(str), hash_seed());
+}
+
+hashcode_t hash_u32_mix(const void *arg){
+        uint32_t x;
+        memcpy(&x, arg, sizeof(x));
+        return mix64(x + hash_seed());
+}
+
+hashcode_t hash_u64_mix(const void *arg){
+        uint64_t x;
+        memcpy(&x, arg, sizeof(x));
+        return mix64(x + hash_seed());
+}
@@ -2,13 +2,17 @@
  * hash_map.c - Hash Map implementation.
  * Author: Saúl Valdelvira (2023)
  */
+#define _POSIX_C_SOURCE 200809L
 #include "hash_map.h"
+#include "hash_map_priv.h"
+#include "frozen_hash_map.h"
 #include "attrs.h"
 #include "error.h"
 #include "definitions.h"
 #include "vector.h"
 #include "compare.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,26 +20,75 @@
 #include <assert.h>
 #include <time.h>
 #include "gdsmalloc.h"
+#include "arena.h"
 
-typedef struct hash_node_t {
-        void *key;
-        void *value;
-        enum NodeState {
-                EMPTY, FULL, DELETED
-        } state;
-} hash_node_t;
+#if defined(__SSE2__) && !defined(GDS_NO_SIMD)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define USE_MMAP
+#endif
+
+/*
+ * A table is a single contiguous array of slots.
+ * Each slot stores the hash of the key, followed by the
+ * key and the value inline, so a lookup never has to chase
+ * pointers and an insertion doesn't need to allocate.
+ *
+ * [ hash | key | pad | value | pad ]
+ *
+ * The hash is computed once per operation. Keeping it in the
+ * slot lets us discard most collisions without calling the
+ * comparator, and redisperse without hashing the keys again.
+ *
+ * The state of the slots is kept apart, in an array of
+ * control bytes (see CONTROL BYTES below), placed right
+ * after the slots in the same memory block.
+ */
+struct table {
+        void *slots;                    ///< Array of slots
+        u8 *ctrl;                       ///< Control bytes of the slots
+        size_t capacity;                ///< Number of slots in the table
+        size_t n_deleted;               ///< Number of DELETED slots
+};
+
+/*
+ * The map has a second table, old, used for incremental rehashing.
+ * While it's not NULL, its elements are being migrated into tab,
+ * a few slots on every put or remove (see REDISPERSE below).
+ *
+ * The offsets are computed once in __init_map, so that
+ * the key and the value are properly aligned.
+ */
 struct hash_map {
-        vector_t *vec_elements;   ///< vector_t to store the elements
+        struct table tab;               ///< Table of elements
+        struct table old;               ///< Table being migrated into tab
+        size_t migrated;                ///< Number of slots of old already migrated
+        size_t rehash_step;             ///< Slots to migrate on every operation (0 means not incremental)
+        size_t n_redispersions;         ///< Number of times the table has been rebuilt
         hash_function_t hash;                   ///< Hashing function pointer
         destructor_function_t destructor;       ///< Destructor function pointer
         comparator_function_t cmp;       ///< Comparator function pointer
-        u32 n_elements;      ///< Number of elements in the hash_map_t
+        size_t n_elements;   ///< Number of elements in the hash_map_t
         u16 value_size;      ///< Size (in bytes) of the value data type
         u16 key_size;        ///< Size (in bytes) of the key data type
+        u32 key_offset;      ///< Offset (in bytes) of the key inside a slot
+        u32 value_offset;    ///< Offset (in bytes) of the value inside a slot
+        u32 slot_size;       ///< Size (in bytes) of a slot
         float max_lf;   ///< Maximun load factor before redispersing
         float min_lf;    ///< Minimun load factor before shrinking
+        float max_deleted;      ///< Maximun ratio of DELETED slots before compacting
         enum Redispersion redispersion;   ///< Type of redispersion to apply
+        enum Sizing sizing;     ///< How the capacity of the tables is chosen
+        void *image;            ///< Snapshot file the table lives in (see SNAPSHOT). NULL if not read only
+        size_t image_size;      ///< Size (in bytes) of the image
+        struct arena *strings;  ///< Copies of the keys (see STRING KEYS). NULL if the keys aren't strings
 };
 
 /**
@@ -45,10 +98,9 @@ struct hash_map {
 */
 #define LF(x,B) ((x) * 1.0 / (B))
 
-#define VEC_SIZE(map) vector_size(map->vec_elements)
+#define IS_REHASHING(map) ((map)->old.slots != NULL)
 
-_const_fn
-static inline int64_t abs_i64(int64_t n) { return n < 0 ? -n : n; }
+#define IS_READ_ONLY(map) ((map)->image != NULL)
 
 /// PRIME //////////////////////////////////////////////////////////////////////
 
@@ -98,48 +150,280 @@ static size_t get_next_size(size_t n){
         return n;
 }
 
+/// POWER OF TWO ///////////////////////////////////////////////////////////////
+
+/*
+ * With POW2_SIZING, the capacity is always a power of two, so the
+ * position is computed with a shift and a mask instead of a division.
+ * The hash is mixed first by multiplying it by 2^64 / phi (Fibonacci
+ * hashing), and the top bits of the product are used as the position.
+ * This spreads hashes like hash_int, that only change in the low bits,
+ * across the whole table.
+ */
+#define POW2_MIN_SIZE 8
+#define FIB_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+_const_fn
+static size_t next_pow2(size_t n){
+        size_t p = POW2_MIN_SIZE;
+        while (p < n && p <= SIZE_MAX / 2)
+                p <<= 1;
+        return p;
+}
+
+_const_fn
+static inline size_t fib_hash(hashcode_t hash, size_t capacity){
+        return (hash * FIB_MULTIPLIER) >> (64 - __builtin_ctzll(capacity));
+}
+
+static size_t __initial_size(const hash_map_t *map){
+        return map->sizing == POW2_SIZING ? POW2_MIN_SIZE : DICT_INITIAL_SIZE;
+}
+
+static size_t __grow_size(const hash_map_t *map, size_t n){
+        if (map->sizing == POW2_SIZING)
+                return n <= SIZE_MAX / 2 ? n * 2 : n;
+        return get_next_size(n);
+}
+
+static size_t __shrink_size(const hash_map_t *map, size_t n){
+        if (map->sizing == POW2_SIZING)
+                return n / 2 >= POW2_MIN_SIZE ? n / 2 : POW2_MIN_SIZE;
+        return get_prev_size(n);
+}
+
+/// CONTROL BYTES //////////////////////////////////////////////////////////////
+
+/*
+ * Every slot has a control byte that describes its state:
+ *  - CTRL_EMPTY:   the slot has never been used.
+ *  - CTRL_DELETED: the slot held an element that was removed.
+ *  - 0b0xxxxxxx:   the slot is full. The 7 low bits are a
+ *                  fragment of the hash of its key (see H2).
+ *
+ * Lookups scan the control bytes and only look at a slot when
+ * its 7 bits match the ones of the key, so a miss mostly reads
+ * one byte per slot. With SWISS_HASHING, a whole group of
+ * GROUP_WIDTH control bytes is matched at once.
+ *
+ * The array has GROUP_WIDTH extra bytes at the end, mirroring
+ * the first ones, so a group can be loaded starting at any
+ * position without having to wrap around.
+ */
+#define CTRL_EMPTY   ((u8) 0x80)
+#define CTRL_DELETED ((u8) 0xFE)
+#define GROUP_WIDTH  16
+
+_const_fn
+static inline bool ctrl_is_full(u8 c){
+        return (c & 0x80) == 0;
+}
+
+/**
+ * Returns the 7 bits of the hash stored in the control byte.
+ * The hash is mixed first, so the bits are not the same that
+ * decide the position of the key (specially with hashes like
+ * hash_int, which only use the low bits).
+ */
+_const_fn
+static inline u8 H2(hashcode_t hash){
+        return (u8) ((hash * 0xC2B2AE3D27D4EB4FULL) >> 57);
+}
+
+#ifdef USE_SSE2
+
+__inline
+static u32 group_match(const u8 *group, u8 h2){
+        __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) h2)));
+}
+
+/**
+ * Matches EMPTY and DELETED control bytes. Those are
+ * the only ones with the high bit set.
+ */
+__inline
+static u32 group_match_free(const u8 *group){
+        __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+        return _mm_movemask_epi8(ctrl);
+}
+
+#else
+
+static inline u32 group_match(const u8 *group, u8 h2){
+        u32 mask = 0;
+        for (int i = 0; i < GROUP_WIDTH; i++) {
+                if (group[i] == h2)
+                        mask |= 1U << i;
+        }
+        return mask;
+}
+
+static inline u32 group_match_free(const u8 *group){
+        u32 mask = 0;
+        for (int i = 0; i < GROUP_WIDTH; i++) {
+                if (!ctrl_is_full(group[i]))
+                        mask |= 1U << i;
+        }
+        return mask;
+}
+
+#endif
+
+__inline
+static u32 group_match_empty(const u8 *group){
+        return group_match(group, CTRL_EMPTY);
+}
+
+/**
+ * Sets the control byte for the given position,
+ * and its mirrors at the end of the array.
+ * It also keeps the count of DELETED slots.
+ */
+__inline
+static void set_ctrl(struct table *t, size_t pos, u8 c){
+        t->n_deleted += (c == CTRL_DELETED) - (t->ctrl[pos] == CTRL_DELETED);
+        t->ctrl[pos] = c;
+        for (size_t i = pos + t->capacity; i < t->capacity + GROUP_WIDTH; i += t->capacity)
+                t->ctrl[i] = c;
+}
+
+/**
+ * Wraps a position that may be past the end of the table.
+ */
+__inline
+static size_t wrap_pos(const struct table *t, size_t pos){
+        return pos < t->capacity ? pos : pos % t->capacity;
+}
+
+/// SLOTS //////////////////////////////////////////////////////////////////////
+
+__inline
+static void* slot_at(const hash_map_t *map, const struct table *t, size_t pos){
+        return void_offset(t->slots, pos * map->slot_size);
+}
+
+__inline
+static hashcode_t* slot_hash(void *slot){
+        return (hashcode_t*) slot;
+}
+
+__inline
+static void* slot_key(const hash_map_t *map, void *slot){
+        return void_offset(slot, map->key_offset);
+}
+
+__inline
+static void* slot_value(const hash_map_t *map, void *slot){
+        return void_offset(slot, map->value_offset);
+}
+
+/**
+ * Fills the slot at the given position with the key.
+ * The value is left for the caller to fill.
+ */
+static void __set_key(hash_map_t *map, struct table *t, size_t pos, hashcode_t hash, const void *key){
+        void *slot = slot_at(map, t, pos);
+        set_ctrl(t, pos, H2(hash));
+        *slot_hash(slot) = hash;
+        memcpy(slot_key(map, slot), key, map->key_size);
+}
+
+/**
+ * Moves the slot at [from] in src to [to] in dst.
+ * The control byte of [from] is left as it is.
+ */
+__inline
+static void __move_slot(hash_map_t *map, struct table *dst, size_t to, const struct table *src, size_t from){
+        memcpy(slot_at(map, dst, to), slot_at(map, src, from), map->slot_size);
+        set_ctrl(dst, to, src->ctrl[from]);
+}
+
 /// INITIALIZE /////////////////////////////////////////////////////////////////
 
 /**
- * Initializes a node.
+ * Computes the layout of the slots for the given key and value sizes.
+ */
+static void __init_layout(hash_map_t *map){
+        size_t key_align = align_of_size(map->key_size);
+        size_t value_align = align_of_size(map->value_size);
+        size_t slot_align = _Alignof(hashcode_t);
+        if (key_align > slot_align)
+                slot_align = key_align;
+        if (value_align > slot_align)
+                slot_align = value_align;
+
+        map->key_offset = align_up(sizeof(hashcode_t), key_align);
+        map->value_offset = align_up(map->key_offset + map->key_size, value_align);
+        map->slot_size = align_up(map->value_offset + map->value_size, slot_align);
+}
+
+/**
+ * Size (in bytes) of the memory block of a table.
+ */
+__inline
+static size_t __table_bytes(const hash_map_t *map, size_t capacity){
+        return capacity * map->slot_size + capacity + GROUP_WIDTH;
+}
+
+/**
+ * Allocates an empty table with the given capacity.
+ * The slots and the control bytes share the same memory block.
  */
-static void init_node(void *node){
-        hash_node_t *n = (hash_node_t*) node;
-        n->key = NULL;
-        n->value = NULL;
-        n->state = EMPTY;
+static int __alloc_table(const hash_map_t *map, struct table *t, size_t capacity){
+        size_t slots_size = capacity * map->slot_size;
+        void *mem = gdsmalloc(__table_bytes(map, capacity));
+        if (!mem)
+                return GDS_ERROR;
+        t->slots = mem;
+        t->ctrl = void_offset(mem, slots_size);
+        t->capacity = capacity;
+        t->n_deleted = 0;
+        memset(t->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+        return GDS_SUCCESS;
 }
 
 /**
- * Frees the memory allocated for a node.
+ * Makes dst a copy of the src table.
  */
-static void free_node(void *node, void *args){
-        destructor_function_t destructor = * (destructor_function_t*) args;
-        hash_node_t *n = (hash_node_t*) node;
-        if (destructor && n->state == FULL)
-                destructor(n->value);
-        free(n->key);
-        free(n->value);
-        n->key = NULL;
-        n->value = NULL;
+static int __dup_table(const hash_map_t *map, struct table *dst, const struct table *src){
+        size_t bytes = __table_bytes(map, src->capacity);
+        void *mem = gdsmalloc(bytes);
+        if (!mem)
+                return GDS_ERROR;
+        memcpy(mem, src->slots, bytes);
+        dst->slots = mem;
+        dst->ctrl = void_offset(mem, src->capacity * map->slot_size);
+        dst->capacity = src->capacity;
+        dst->n_deleted = src->n_deleted;
+        return GDS_SUCCESS;
 }
 
 __inline
 static int __init_map(hash_map_t *map, size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity) {
+        if (capacity == 0)
+                capacity = DICT_INITIAL_SIZE;
         map->value_size = value_size;
         map->key_size = key_size;
         map->min_lf = DICT_DEF_MIN_LF;
         map->max_lf = DICT_DEF_MAX_LF;
+        map->max_deleted = DICT_DEF_MAX_DELETED;
         map->cmp = cmp;
         map->destructor = NULL;
-        map->vec_elements = vector_init(sizeof(hash_node_t), compare_equal);
-        if (!map->vec_elements){
+        __init_layout(map);
+        if (__alloc_table(map, &map->tab, capacity) != GDS_SUCCESS)
                 return GDS_ERROR;
-        }
-        vector_resize(map->vec_elements, capacity, init_node);
+        map->old = (struct table) {0};
+        map->migrated = 0;
+        map->rehash_step = 0;
+        map->n_redispersions = 0;
         map->n_elements = 0;
         map->hash = hash_func;
         map->redispersion = DICT_DEF_REDISPERSION;
+        map->sizing = PRIME_SIZING;
+        map->image = NULL;
+        map->image_size = 0;
+        map->strings = NULL;
         return GDS_SUCCESS;
 }
 
@@ -148,18 +432,139 @@ hash_map_t* hashmap_with_capacity(size_t key_size, size_t value_size, hash_funct
         hash_map_t *map = gdsmalloc(sizeof(*map));
         if (!map) return NULL;
         if ( __init_map(map, key_size, value_size, hash_func, cmp, capacity) != GDS_SUCCESS) {
-                free(map);
+                gdsfree(map);
                 return NULL;
         }
         return map;
 }
 
+static int __dup_strings(hash_map_t *dup);
+
+hash_map_t* hashmap_dup(const hash_map_t *map){
+        assert(map);
+        hash_map_t *dup = gdsmalloc(sizeof(*dup));
+        if (!dup) return NULL;
+        *dup = *map;
+        /* The copy of a read only map lives in the heap, so it can be modified */
+        dup->image = NULL;
+        dup->image_size = 0;
+        if (__dup_table(map, &dup->tab, &map->tab) != GDS_SUCCESS) {
+                gdsfree(dup);
+                return NULL;
+        }
+        if (IS_REHASHING(map) && __dup_table(map, &dup->old, &map->old) != GDS_SUCCESS) {
+                gdsfree(dup->tab.slots);
+                gdsfree(dup);
+                return NULL;
+        }
+        if (map->strings && __dup_strings(dup) != GDS_SUCCESS) {
+                dup->destructor = NULL;
+                hashmap_free(dup);
+                return NULL;
+        }
+        return dup;
+}
+
 inline hash_map_t* hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp){
         return hashmap_with_capacity(key_size, value_size, hash_func, cmp, DICT_INITIAL_SIZE);
 }
 
+/// STRING KEYS ////////////////////////////////////////////////////////////////
+
+/*
+ * In a map with string keys, the key of a slot is a char* to a copy
+ * of the string in the map's arena, with its length stored before it.
+ *
+ * The public functions take the key as a pointer to a char*, and turn
+ * it into a string_probe with the length of the string. The probe is
+ * what map->hash and map->cmp receive, so the string is only walked
+ * once per operation, and a slot whose hash matches is discarded by
+ * its length before comparing any byte.
+ */
+struct string_probe {
+        const char *str;
+        size_t len;
+};
+
+static hashcode_t __hash_string_probe(const void *arg){
+        const struct string_probe *p = arg;
+        return hash_bytes(p->str, p->len, hash_seed());
+}
+
+static int __cmp_string_probe(const void *probe, const void *key){
+        const struct string_probe *p = probe;
+        const char *str = * (char**) key;
+        size_t len = arena_strlen(str);
+        if (p->len != len)
+                return p->len < len ? -1 : 1;
+        return memcmp(p->str, str, len);
+}
+
+/**
+ * Returns the key the internal functions expect.
+ * For string keys, it fills the probe and returns it.
+ */
+__inline
+static const void* __key_arg(const hash_map_t *map, const void *key, struct string_probe *probe){
+        if (!map->strings)
+                return key;
+        probe->str = * (char**) key;
+        probe->len = strlen(probe->str);
+        return probe;
+}
+
+hash_map_t* hashmap_init_string_keys(size_t value_size){
+        hash_map_t *map = hashmap_init(sizeof(char*), value_size, __hash_string_probe, __cmp_string_probe);
+        if (!map) return NULL;
+        map->strings = arena_init();
+        if (!map->strings) {
+                hashmap_free(map);
+                return NULL;
+        }
+        return map;
+}
+
+/**
+ * Makes the keys of the table point to copies in the map's arena.
+ */
+static int __copy_strings(hash_map_t *map, struct table *t){
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (!ctrl_is_full(t->ctrl[i]))
+                        continue;
+                char **key = slot_key(map, slot_at(map, t, i));
+                *key = arena_strndup(map->strings, *key, arena_strlen(*key));
+                if (!*key)
+                        return GDS_NOMEM_ERROR;
+        }
+        return GDS_SUCCESS;
+}
+
+/**
+ * Gives a copy of a map with string keys its own arena.
+ * On error, the keys left in dup may point to the original map's
+ * arena, so dup must be freed without calling the destructor.
+ */
+static int __dup_strings(hash_map_t *dup){
+        dup->strings = arena_init();
+        if (!dup->strings)
+                return GDS_NOMEM_ERROR;
+        int status = __copy_strings(dup, &dup->tab);
+        if (status == GDS_SUCCESS && IS_REHASHING(dup))
+                status = __copy_strings(dup, &dup->old);
+        return status;
+}
+
+static int hashmap_redisperse(hash_map_t *map, size_t new_size);
+static int __finish_rehash(hash_map_t *map);
+
 int hashmap_configure(hash_map_t *map, enum Redispersion redispersion, double min_lf, double max_lf){
         assert(map);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        /* The enum may be unsigned, so -1 is compared as an unsigned value */
+        bool keep = (unsigned) redispersion == (unsigned) DICT_KEEP_REDISPERSION;
+        if (!keep && (unsigned) redispersion > ROBIN_HOOD_HASHING)
+                return GDS_INVALID_PARAMETER_ERROR;
         float min, max;
         if (min_lf > 0.0f || min_lf == DICT_NO_SHRINKING)
                 min = min_lf;
@@ -177,8 +582,22 @@ int hashmap_configure(hash_map_t *map, enum Redispersion redispersion, double mi
         map->min_lf = min;
         map->max_lf = max;
 
-        if (redispersion >= 0)
+        if (!keep && redispersion != map->redispersion) {
+                int status = __finish_rehash(map);
+                if (status != GDS_SUCCESS)
+                        return status;
+                enum Redispersion prev = map->redispersion;
                 map->redispersion = redispersion;
+                /* The elements already in the table were placed following
+                   the previous probe sequence, so they must be moved. */
+                if (map->n_elements > 0) {
+                        status = hashmap_redisperse(map, map->tab.capacity);
+                        if (status != GDS_SUCCESS) {
+                                map->redispersion = prev;
+                                return status;
+                        }
+                }
+        }
 
         return GDS_SUCCESS;
 }
@@ -189,239 +608,1042 @@ void hashmap_set_destructor(hash_map_t *map, destructor_function_t value_destruc
                 map->destructor = value_destructor;
 }
 
-static inline void hashmap_free_contents(hash_map_t *map) {
-        assert(map);
-        vector_map(map->vec_elements, free_node, &map->destructor);
-        vector_free(map->vec_elements);
+/**
+ * Calls the destructor on every value of the table.
+ */
+static void destroy_content(hash_map_t *map, struct table *t){
+        if (!map->destructor)
+                return;
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (ctrl_is_full(t->ctrl[i]))
+                        map->destructor(slot_value(map, slot_at(map, t, i)));
+        }
 }
 
+static void __unmap_image(void *image, size_t size);
 
-static bool __are_equal(const hash_map_t *map, const void *e1, const void *e2) {
-        int64_t h1 = map->hash(e1);
-        int64_t h2 = map->hash(e2);
-        if (h1 == h2) {
-                int c = map->cmp(e1, e2);
-                if (c == 0)
-                        return true;
-
+static inline void hashmap_free_contents(hash_map_t *map) {
+        assert(map);
+        if (IS_READ_ONLY(map)) {
+                /* The values of a snapshot are plain data, so
+                   the destructor isn't called on them */
+                __unmap_image(map->image, map->image_size);
+                return;
+        }
+        destroy_content(map, &map->tab);
+        gdsfree(map->tab.slots);
+        if (IS_REHASHING(map)) {
+                destroy_content(map, &map->old);
+                gdsfree(map->old.slots);
         }
-        return false;
+        arena_free(map->strings);
 }
 
-//// REDISPERSE ///////////////////////////////////////////////////////////////
-
-static int __delete_node(hash_map_t *map, size_t pos, bool redispersion, bool destroy);
-
 /**
- * Redisperses the hash_map.
- * Can be used to expand or shrink the table.
+ * Checks if the slot holds the given key.
+ * The hashes are compared first, so the comparator
+ * is only called when they match.
  */
-static int hashmap_redisperse(hash_map_t *map, size_t new_size){
-        assert(map->n_elements < new_size);
-
-        hash_map_t d;
-        __init_map(&d, map->key_size, map->value_size, map->hash, map->cmp, new_size);
-        d.destructor = map->destructor;
-
-        for (size_t i = 0; i < VEC_SIZE(map); i++) {
-                hash_node_t node;
-                vector_at(map->vec_elements, i, &node);
-                if (node.state == FULL) {
-                        int status = hashmap_put(&d, node.key, node.value);
-                        if (status != GDS_SUCCESS) {
-                                hashmap_free(&d);
-                                return status;
-                        }
-                        __delete_node(map, i, false, false);
-                }
-        }
-
-        hashmap_free_contents(map);
-        memcpy(map, &d, sizeof(hash_map_t));
-        return GDS_SUCCESS;
+__inline
+static bool __are_equal(const hash_map_t *map, void *slot, const void *key, hashcode_t hash) {
+        return *slot_hash(slot) == hash
+               && map->cmp(key, slot_key(map, slot)) == 0;
 }
 
-//// PUT //////////////////////////////////////////////////////////////////////
+//// FIND /////////////////////////////////////////////////////////////////////
 
 /**
  * Retuns an index to store the key into
+ * With SWISS_HASHING, the index is the start of a group.
+ * @param hash hash of the key
  * @param n_it number of tries, to handle collisions.
  */
-static size_t hashmap_get_pos(const hash_map_t *map, void *key, size_t n_it){
-        size_t pos = 0;
+static size_t hashmap_get_pos(const hash_map_t *map, const struct table *t, hashcode_t hash, size_t n_it){
+        bool pow2 = map->sizing == POW2_SIZING;
+        size_t pos = pow2 ? fib_hash(hash, t->capacity) : hash;
         switch (map->redispersion){
         case LINEAR_HASHING:
-                pos = abs_i64(map->hash(key)) + n_it;
+        case ROBIN_HOOD_HASHING:
+                pos += n_it;
                 break;
         case QUADRATIC_HASHING:
-                pos =  abs_i64(map->hash(key)) + n_it * n_it;
+                /* With a power of two capacity, n*n doesn't visit every
+                   slot. The triangular numbers n*(n+1)/2 do. */
+                pos += pow2 ? n_it * (n_it + 1) / 2 : n_it * n_it;
+                break;
+        case SWISS_HASHING:
+                pos += n_it * GROUP_WIDTH;
                 break;
         }
-        return pos % VEC_SIZE(map);
+        return pow2 ? pos & (t->capacity - 1) : pos % t->capacity;
 }
 
-int hashmap_put(hash_map_t *map, void *key, void *value){
-        assert(map && key);
-        if (map->value_size != 0)
-                assert(value);
-        size_t pos = 0;
-        hash_node_t node = {0};
-
-        for (size_t i = 0; i < VEC_SIZE(map); ++i){
-                pos = hashmap_get_pos(map, key, i);
-                vector_at(map->vec_elements, pos, &node);
-
-                if (node.state == FULL){
-                        if (__are_equal(map, key, node.key))
-                                break;
-                }else {
-                        break;
+/**
+ * __find for SWISS_HASHING.
+ * Checks GROUP_WIDTH slots per iteration. The groups are visited
+ * one after the other, so the order in which the slots are checked
+ * is the same as with LINEAR_HASHING. We can stop at the first group
+ * that has an EMPTY slot, since the key would have been put there.
+ */
+static ptrdiff_t __find_group(const hash_map_t *map, const struct table *t, const void *key, hashcode_t hash, ptrdiff_t *insert){
+        u8 h2 = H2(hash);
+        ptrdiff_t ins = -1;
+        for (size_t i = 0; i * GROUP_WIDTH < t->capacity; i++) {
+                size_t pos = hashmap_get_pos(map, t, hash, i);
+                const u8 *group = &t->ctrl[pos];
+                for (u32 match = group_match(group, h2); match; match &= match - 1) {
+                        size_t p = wrap_pos(t, pos + __builtin_ctz(match));
+                        if (__are_equal(map, slot_at(map, t, p), key, hash)) {
+                                if (insert)
+                                        *insert = ins;
+                                return p;
+                        }
                 }
-        }
-
-        /* if the node is empty, we need to allocate
-           memory for the key and value. */
-        if (!node.key){
-                node.key = gdsmalloc(map->key_size);
-                if (!node.key)
-                        return GDS_ERROR;
-        }
-        if (!node.value){
-                node.value = gdsmalloc(map->value_size);
-                if (!node.value){
-                        free(node.key);
-                        return GDS_ERROR;
+                if (ins < 0) {
+                        u32 avail = group_match_free(group);
+                        if (avail)
+                                ins = wrap_pos(t, pos + __builtin_ctz(avail));
                 }
+                if (group_match_empty(group))
+                        break;
         }
+        if (insert)
+                *insert = ins;
+        return -1;
+}
 
-        if (node.state == FULL && map->destructor)
-                        map->destructor(node.value);
-
-        if (node.state != FULL)
-                map->n_elements++;
-
-        memcpy(node.key, key, map->key_size);
-        memcpy(node.value, value, map->value_size);
+__inline
+static size_t next_pos(const struct table *t, size_t pos){
+        return pos + 1 < t->capacity ? pos + 1 : 0;
+}
 
-        node.state = FULL;
+__inline
+static size_t prev_pos(const struct table *t, size_t pos){
+        return pos > 0 ? pos - 1 : t->capacity - 1;
+}
 
-        /* Very important!. We need to copy back the node into the vector.
-           Remember that the get function returns a COPY of the element. */
-        vector_set_at(map->vec_elements, pos, &node);
+/**
+ * Distance from the slot at the given position to the
+ * home position of its key (where the probe sequence starts).
+ */
+__inline
+static size_t probe_distance(const hash_map_t *map, const struct table *t, size_t pos){
+        size_t home = hashmap_get_pos(map, t, *slot_hash(slot_at(map, t, pos)), 0);
+        return pos >= home ? pos - home : pos + t->capacity - home;
+}
 
-        // Resize if needed
-        if (LF(map->n_elements, VEC_SIZE(map)) >= map->max_lf){
-                size_t new_size = get_next_size(VEC_SIZE(map));
-                int status = hashmap_redisperse(map, new_size);
-                if (status != GDS_SUCCESS)
-                        return status;
+/**
+ * __find for ROBIN_HOOD_HASHING.
+ * The elements of a cluster are kept sorted by their home position,
+ * so we can stop as soon as we find an element closer to its home
+ * than we are to ours: the key would have taken that slot.
+ * That position is also where the key must be inserted.
+ */
+static ptrdiff_t __find_robin_hood(const hash_map_t *map, const struct table *t, const void *key, hashcode_t hash, ptrdiff_t *insert){
+        u8 h2 = H2(hash);
+        size_t pos = hashmap_get_pos(map, t, hash, 0);
+        ptrdiff_t ins = -1;
+        ptrdiff_t found = -1;
+        for (size_t dist = 0; dist < t->capacity; dist++) {
+                u8 c = t->ctrl[pos];
+                if (c == CTRL_EMPTY || probe_distance(map, t, pos) < dist) {
+                        /* If the table is full, there's nowhere to shift to */
+                        if (map->n_elements < t->capacity)
+                                ins = pos;
+                        break;
+                }
+                if (c == h2 && __are_equal(map, slot_at(map, t, pos), key, hash)) {
+                        found = pos;
+                        break;
+                }
+                pos = next_pos(t, pos);
         }
-        return GDS_SUCCESS;
+        if (insert)
+                *insert = ins;
+        return found;
 }
 
-//// GET_EXISTS ///////////////////////////////////////////////////////////////
+/**
+ * Makes room for a new element at the given position.
+ * With ROBIN_HOOD_HASHING, the position may be taken by an element
+ * that is closer to its home. In that case, it and the rest of the
+ * cluster are shifted one slot forward.
+ */
+static void __claim(hash_map_t *map, struct table *t, size_t pos){
+        if (map->redispersion != ROBIN_HOOD_HASHING || !ctrl_is_full(t->ctrl[pos]))
+                return;
+        size_t empty = pos;
+        while (ctrl_is_full(t->ctrl[empty]))
+                empty = next_pos(t, empty);
+        for (size_t i = empty; i != pos; i = prev_pos(t, i))
+                __move_slot(map, t, i, t, prev_pos(t, i));
+        set_ctrl(t, pos, CTRL_EMPTY);
+}
 
-void* hashmap_get(const hash_map_t *map, void *key, void *dest){
-        assert(map && key);
-        for (size_t i = 0; i < VEC_SIZE(map); i++) {
-                size_t pos = hashmap_get_pos(map, key, i);
-                hash_node_t node;
-                vector_at(map->vec_elements, pos, &node);
-                if (node.state == FULL){
-                        if (__are_equal(map, key, node.key))
-                                return memcpy(dest, node.value, map->value_size);
-                }
-                if (node.state == EMPTY) break;
+/**
+ * Removes the element at the given position.
+ * With ROBIN_HOOD_HASHING, instead of leaving a DELETED mark, the
+ * elements that follow it are shifted one slot back, until we find
+ * an empty slot or an element that is already in its home position.
+ * This way, the table never has tombstones.
+ *
+ * The old table always uses DELETED marks. Nothing moves there
+ * while it's being migrated.
+ */
+static void __erase(hash_map_t *map, struct table *t, size_t pos){
+        if (map->redispersion != ROBIN_HOOD_HASHING || t == &map->old) {
+                set_ctrl(t, pos, CTRL_DELETED);
+                return;
         }
-        return NULL;
+        for (size_t next = next_pos(t, pos);
+             ctrl_is_full(t->ctrl[next]) && probe_distance(map, t, next) > 0;
+             next = next_pos(t, next))
+        {
+                __move_slot(map, t, pos, t, next);
+                pos = next;
+        }
+        set_ctrl(t, pos, CTRL_EMPTY);
 }
 
-void* hashmap_get_ref(const hash_map_t *map, void *key){
-        assert(map && key);
-        for (size_t i = 0; i < VEC_SIZE(map); i++) {
-                size_t pos = hashmap_get_pos(map, key, i);
-                hash_node_t node;
-                vector_at(map->vec_elements, pos, &node);
-                if (node.state == FULL){
-                        if (__are_equal(map, key, node.key))
-                                return node.value;
+/**
+ * Looks for the slot of the table that holds the given key.
+ * @param hash hash of the key, as returned by map->hash
+ * @param[out] insert if not NULL, it's set to the first position in
+ *                    the probe sequence where the key could be inserted,
+ *                    or -1 if there's no room for it.
+ * @return the position of the key, or -1 if it isn't in the table.
+ */
+static ptrdiff_t __find(const hash_map_t *map, const struct table *t, const void *key, hashcode_t hash, ptrdiff_t *insert){
+        if (map->redispersion == SWISS_HASHING)
+                return __find_group(map, t, key, hash, insert);
+        if (map->redispersion == ROBIN_HOOD_HASHING)
+                return __find_robin_hood(map, t, key, hash, insert);
+
+        u8 h2 = H2(hash);
+        ptrdiff_t ins = -1;
+        ptrdiff_t found = -1;
+        for (size_t i = 0; i < t->capacity; i++) {
+                size_t pos = hashmap_get_pos(map, t, hash, i);
+                u8 c = t->ctrl[pos];
+                if (c == h2){
+                        if (__are_equal(map, slot_at(map, t, pos), key, hash)){
+                                found = pos;
+                                break;
+                        }
+                } else if (!ctrl_is_full(c)) {
+                        if (ins < 0)
+                                ins = pos;
+                        if (c == CTRL_EMPTY)
+                                break;
                 }
-                if (node.state == EMPTY) break;
         }
-        return NULL;
+        if (insert)
+                *insert = ins;
+        return found;
 }
 
-bool hashmap_exists(const hash_map_t *map, void *key){
-        assert(map && key);
-        for (size_t i = 0; i < VEC_SIZE(map); i++) {
-                size_t pos = hashmap_get_pos(map, key, i);
-                hash_node_t node;
-                vector_at(map->vec_elements, pos, &node);
-                if (node.state == FULL){
-                        if (__are_equal(map, key, node.key))
-                                return true;
-                }
-                if (node.state == EMPTY) break;
+/**
+ * Looks for the key in the map.
+ * If the map is being rehashed, the key may still be in the old table.
+ * @param[out] in_old set to true if the key was found in the old table.
+ * @param[out] insert see __find. Always refers to the current table.
+ * @return the position of the key, or -1 if it isn't in the map.
+ */
+static ptrdiff_t __lookup(const hash_map_t *map, const void *key, hashcode_t hash, bool *in_old, ptrdiff_t *insert){
+        *in_old = false;
+        ptrdiff_t pos = __find(map, &map->tab, key, hash, insert);
+        if (pos < 0 && IS_REHASHING(map)) {
+                pos = __find(map, &map->old, key, hash, NULL);
+                *in_old = pos >= 0;
         }
-        return false;
+        return pos;
 }
 
-vector_t* hashmap_keys(const hash_map_t *map) {
-        assert(map);
-        vector_t *v = vector_with_capacity(map->key_size, compare_equal, map->n_elements);
-        if (!v) return NULL;
-
-        for (size_t i = 0; i < VEC_SIZE(map); i++) {
-                hash_node_t node;
-                vector_at(map->vec_elements, i, &node);
-                if (node.state == FULL) {
-                        if (vector_append(v, node.key) != GDS_SUCCESS) {
-                                vector_free(v);
-                                return NULL;
+/**
+ * Returns the first free position in the probe sequence of the given hash,
+ * or -1 if there's none. Only used when we already know the key is not in the table.
+ * The position is ready to be filled (see __claim).
+ */
+static ptrdiff_t __find_free(hash_map_t *map, struct table *t, hashcode_t hash){
+        if (map->redispersion == ROBIN_HOOD_HASHING) {
+                if (map->n_elements >= t->capacity)
+                        return -1;
+                size_t pos = hashmap_get_pos(map, t, hash, 0);
+                for (size_t dist = 0; dist < t->capacity; dist++) {
+                        if (!ctrl_is_full(t->ctrl[pos]) || probe_distance(map, t, pos) < dist) {
+                                __claim(map, t, pos);
+                                return pos;
                         }
+                        pos = next_pos(t, pos);
                 }
+                return -1;
+        }
+        if (map->redispersion == SWISS_HASHING) {
+                for (size_t i = 0; i * GROUP_WIDTH < t->capacity; i++) {
+                        size_t pos = hashmap_get_pos(map, t, hash, i);
+                        u32 avail = group_match_free(&t->ctrl[pos]);
+                        if (avail)
+                                return wrap_pos(t, pos + __builtin_ctz(avail));
+                }
+                return -1;
+        }
+        for (size_t i = 0; i < t->capacity; i++) {
+                size_t pos = hashmap_get_pos(map, t, hash, i);
+                if (!ctrl_is_full(t->ctrl[pos]))
+                        return pos;
+        }
+        return -1;
+}
+
+//// REDISPERSE ///////////////////////////////////////////////////////////////
+
+/**
+ * Redisperses the current table of the hash_map.
+ * Can be used to expand or shrink the table.
+ * The slots are moved as they are, using the hash stored
+ * in them, since we already know that their keys are all
+ * different. The hash function is never called here.
+ */
+static int hashmap_redisperse(hash_map_t *map, size_t new_size){
+        assert(map->n_elements < new_size);
+
+        struct table t;
+        if (__alloc_table(map, &t, new_size) != GDS_SUCCESS)
+                return GDS_ERROR;
+
+        for (size_t i = 0; i < map->tab.capacity; i++) {
+                if (!ctrl_is_full(map->tab.ctrl[i]))
+                        continue;
+                ptrdiff_t dst = __find_free(map, &t, *slot_hash(slot_at(map, &map->tab, i)));
+                if (dst < 0) {
+                        gdsfree(t.slots);
+                        return GDS_ERROR;
+                }
+                __move_slot(map, &t, dst, &map->tab, i);
+        }
+
+        gdsfree(map->tab.slots);
+        map->tab = t;
+        map->n_redispersions++;
+        return GDS_SUCCESS;
+}
+
+/*
+ * Compaction.
+ *
+ * DELETED slots are only reused when an insertion walks over them,
+ * so after lots of removals they make the probe sequences longer.
+ * Compacting rehashes the table in place, at the same capacity, so
+ * no second table is needed:
+ *
+ * 1. Every DELETED slot becomes EMPTY, and every full slot is marked
+ *    DELETED, meaning "not placed yet".
+ * 2. Each marked element is moved to the first slot of its probe
+ *    sequence that is not taken by an already placed element:
+ *    - If it's its own slot, it stays there.
+ *    - If it's EMPTY, the element moves there.
+ *    - If it's marked, both elements are swapped, and the one that
+ *      comes into this slot is placed next.
+ *
+ * A placed element never moves again, and every slot before it in its
+ * probe sequence is full, so it can be found once the marks are gone.
+ */
+
+/**
+ * Swaps the contents of two slots, without a temporary slot.
+ */
+static void __swap_slots(hash_map_t *map, struct table *t, size_t a, size_t b){
+        u8 tmp[64];
+        u8 *pa = slot_at(map, t, a), *pb = slot_at(map, t, b);
+        for (size_t done = 0; done < map->slot_size; done += sizeof(tmp)) {
+                size_t len = map->slot_size - done < sizeof(tmp) ? map->slot_size - done : sizeof(tmp);
+                memcpy(tmp, pa + done, len);
+                memcpy(pa + done, pb + done, len);
+                memcpy(pb + done, tmp, len);
+        }
+}
+
+/**
+ * Returns the position where the element at [pos] should be placed:
+ * the first slot of its probe sequence that is not placed yet.
+ * With SWISS_HASHING, if [pos] is in the first group with a free
+ * slot, the element can stay where it is.
+ */
+static size_t __compact_target(const hash_map_t *map, const struct table *t, size_t pos){
+        hashcode_t hash = *slot_hash(slot_at(map, t, pos));
+        size_t width = map->redispersion == SWISS_HASHING ? GROUP_WIDTH : 1;
+        for (size_t i = 0; i < t->capacity; i++) {
+                size_t start = hashmap_get_pos(map, t, hash, i);
+                ptrdiff_t target = -1;
+                for (size_t j = 0; j < width; j++) {
+                        size_t p = wrap_pos(t, start + j);
+                        if (p == pos)
+                                return pos;
+                        if (target < 0 && !ctrl_is_full(t->ctrl[p]))
+                                target = p;
+                }
+                if (target >= 0)
+                        return target;
+        }
+        return pos;
+}
+
+static void __compact(hash_map_t *map, struct table *t){
+        for (size_t i = 0; i < t->capacity; i++)
+                set_ctrl(t, i, ctrl_is_full(t->ctrl[i]) ? CTRL_DELETED : CTRL_EMPTY);
+
+        for (size_t i = 0; i < t->capacity; i++) {
+                while (t->ctrl[i] == CTRL_DELETED) {
+                        u8 h2 = H2(*slot_hash(slot_at(map, t, i)));
+                        size_t target = __compact_target(map, t, i);
+                        if (target == i) {
+                                set_ctrl(t, i, h2);
+                        } else if (t->ctrl[target] == CTRL_EMPTY) {
+                                memcpy(slot_at(map, t, target), slot_at(map, t, i), map->slot_size);
+                                set_ctrl(t, target, h2);
+                                set_ctrl(t, i, CTRL_EMPTY);
+                        } else {
+                                __swap_slots(map, t, i, target);
+                                set_ctrl(t, target, h2);
+                        }
+                }
+        }
+        assert(t->n_deleted == 0);
+}
+
+/**
+ * Returns true if the current table has more DELETED
+ * slots than the configured threshold.
+ */
+__inline
+static bool __needs_compaction(const hash_map_t *map){
+        return map->max_deleted > 0 && !IS_REHASHING(map)
+               && LF(map->tab.n_deleted, map->tab.capacity) > map->max_deleted;
+}
+
+int hashmap_compact(hash_map_t *map){
+        assert(map);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        int status = __finish_rehash(map);
+        if (status != GDS_SUCCESS)
+                return status;
+        if (map->tab.n_deleted > 0)
+                __compact(map, &map->tab);
+        return GDS_SUCCESS;
+}
+
+int hashmap_set_tombstone_threshold(hash_map_t *map, double max_deleted){
+        assert(map);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        if (max_deleted >= 1.0)
+                return GDS_INVALID_PARAMETER_ERROR;
+        map->max_deleted = max_deleted;
+        if (__needs_compaction(map))
+                __compact(map, &map->tab);
+        return GDS_SUCCESS;
+}
+
+/*
+ * Incremental rehashing.
+ *
+ * When rehash_step is not 0, resizing the map doesn't move all the
+ * elements at once. Instead, a new table is allocated and the current
+ * one becomes the old table. Every put and remove then migrates
+ * rehash_step slots of the old table into the new one, so the cost of
+ * the resize is spread across many operations.
+ *
+ * While both tables coexist, new keys always go to tab, and lookups
+ * check tab first and then old. Migrated and removed slots of the old
+ * table are marked DELETED, so the probe sequences of the keys that
+ * are still there are not broken.
+ */
+
+/**
+ * Migrates up to [budget] slots from the old table into the current one.
+ * When every slot has been migrated, the old table is freed.
+ */
+static int __migrate(hash_map_t *map, size_t budget){
+        struct table *old = &map->old;
+        for (; budget > 0 && map->migrated < old->capacity; budget--) {
+                size_t i = map->migrated;
+                if (ctrl_is_full(old->ctrl[i])) {
+                        ptrdiff_t dst = __find_free(map, &map->tab, *slot_hash(slot_at(map, old, i)));
+                        if (dst < 0) {
+                                /* No room in the probe sequence (QUADRATIC_HASHING).
+                                   Grow the current table, and try again. */
+                                int status = hashmap_redisperse(map, __grow_size(map, map->tab.capacity));
+                                if (status != GDS_SUCCESS)
+                                        return status;
+                                continue;
+                        }
+                        __move_slot(map, &map->tab, dst, old, i);
+                        set_ctrl(old, i, CTRL_DELETED);
+                }
+                map->migrated++;
+        }
+        if (map->migrated >= old->capacity) {
+                gdsfree(old->slots);
+                *old = (struct table) {0};
+                map->migrated = 0;
+        }
+        return GDS_SUCCESS;
+}
+
+/**
+ * Migrates all the remaining slots of the old table, if any.
+ */
+static int __finish_rehash(hash_map_t *map){
+        if (!IS_REHASHING(map))
+                return GDS_SUCCESS;
+        return __migrate(map, SIZE_MAX);
+}
+
+/**
+ * Resizes the current table.
+ * If the map is configured to rehash incrementally, this only
+ * allocates the new table, and migrates the first few slots.
+ */
+static int __resize(hash_map_t *map, size_t new_size){
+        int status = __finish_rehash(map);
+        if (status != GDS_SUCCESS)
+                return status;
+        if (map->rehash_step == 0)
+                return hashmap_redisperse(map, new_size);
+
+        struct table t;
+        if (__alloc_table(map, &t, new_size) != GDS_SUCCESS)
+                return GDS_ERROR;
+        map->old = map->tab;
+        map->tab = t;
+        map->migrated = 0;
+        map->n_redispersions++;
+        return __migrate(map, map->rehash_step);
+}
+
+int hashmap_reserve(hash_map_t *map, size_t n){
+        assert(map);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        size_t new_size = map->tab.capacity;
+        while (LF(n, new_size) >= map->max_lf) {
+                size_t next = __grow_size(map, new_size);
+                if (next <= new_size)
+                        return GDS_NOMEM_ERROR;
+                new_size = next;
+        }
+        if (new_size == map->tab.capacity)
+                return GDS_SUCCESS;
+        int status = __finish_rehash(map);
+        if (status != GDS_SUCCESS)
+                return status;
+        return hashmap_redisperse(map, new_size);
+}
+
+void hashmap_set_incremental_rehash(hash_map_t *map, size_t step){
+        assert(map);
+        map->rehash_step = step;
+        if (step == 0)
+                __finish_rehash(map);
+}
+
+bool hashmap_rehash_step(hash_map_t *map, size_t budget){
+        assert(map);
+        if (IS_REHASHING(map))
+                __migrate(map, budget);
+        return IS_REHASHING(map);
+}
+
+bool hashmap_is_rehashing(const hash_map_t *map){
+        assert(map);
+        return IS_REHASHING(map);
+}
+
+int hashmap_set_sizing(hash_map_t *map, enum Sizing sizing){
+        assert(map);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        if (sizing == map->sizing)
+                return GDS_SUCCESS;
+        int status = __finish_rehash(map);
+        if (status != GDS_SUCCESS)
+                return status;
+
+        size_t new_size;
+        if (sizing == POW2_SIZING)
+                new_size = next_pow2(map->tab.capacity);
+        else
+                new_size = get_next_size(map->tab.capacity - 1);
+
+        enum Sizing prev = map->sizing;
+        map->sizing = sizing;
+        /* The positions depend on the sizing, so every
+           element must be moved, even if the map is empty */
+        status = hashmap_redisperse(map, new_size);
+        if (status != GDS_SUCCESS)
+                map->sizing = prev;
+        return status;
+}
+
+//// PUT //////////////////////////////////////////////////////////////////////
+
+/**
+ * Looks for the slot of the key, and inserts the key if it's missing.
+ * This way, both things are done with a single probe sequence.
+ * The value of a new slot is left uninitialized.
+ * @param hash hash of the key
+ * @param[out] inserted set to true if the key was inserted
+ * @param[out] slot set to the slot of the key
+ */
+static int __find_or_insert(hash_map_t *map, const void *key, hashcode_t hash, bool *inserted, void **slot){
+        if (IS_REHASHING(map)) {
+                int status = __migrate(map, map->rehash_step);
+                if (status != GDS_SUCCESS)
+                        return status;
+        }
+
+        ptrdiff_t pos;
+        bool in_old;
+        ptrdiff_t found = __lookup(map, key, hash, &in_old, &pos);
+        if (found >= 0){
+                *slot = slot_at(map, in_old ? &map->old : &map->tab, found);
+                *inserted = false;
+                return GDS_SUCCESS;
+        }
+
+        while (pos < 0){
+                /* There's no room left in the probe sequence
+                   of this key. Grow the table and try again. */
+                int status = hashmap_redisperse(map, __grow_size(map, map->tab.capacity));
+                if (status != GDS_SUCCESS)
+                        return status;
+                pos = __find_free(map, &map->tab, hash);
+        }
+
+        /* The slot of a string key holds a pointer to its copy.
+           The probe is still needed to look the key up below. */
+        const void *stored = key;
+        char *copy;
+        if (map->strings) {
+                const struct string_probe *p = key;
+                copy = arena_strndup(map->strings, p->str, p->len);
+                if (!copy)
+                        return GDS_NOMEM_ERROR;
+                stored = &copy;
+        }
+        __claim(map, &map->tab, pos);
+        __set_key(map, &map->tab, pos, hash, stored);
+        map->n_elements++;
+        *inserted = true;
+
+        // Resize if needed
+        if (LF(map->n_elements, map->tab.capacity) >= map->max_lf){
+                size_t new_size = __grow_size(map, map->tab.capacity);
+                /* If it fails, the key is in anyway. The
+                   next insertion will try to grow again. */
+                if (__resize(map, new_size) == GDS_SUCCESS) {
+                        found = __lookup(map, key, hash, &in_old, NULL);
+                        assert(found >= 0);
+                        *slot = slot_at(map, in_old ? &map->old : &map->tab, found);
+                        return GDS_SUCCESS;
+                }
+        }
+        *slot = slot_at(map, &map->tab, pos);
+        return GDS_SUCCESS;
+}
+
+/**
+ * Puts the key-value pair, given the hash of the key.
+ */
+static int __put(hash_map_t *map, const void *key, hashcode_t hash, const void *value){
+        bool inserted;
+        void *slot;
+        int status = __find_or_insert(map, key, hash, &inserted, &slot);
+        if (status != GDS_SUCCESS)
+                return status;
+        void *dst = slot_value(map, slot);
+        if (!inserted && map->destructor)
+                map->destructor(dst);
+        if (map->value_size)
+                memcpy(dst, value, map->value_size);
+        return GDS_SUCCESS;
+}
+
+hash_map_t* hashmap_from_arrays(const void *keys, const void *values, size_t n, size_t key_size, size_t value_size,
+                                hash_function_t hash_func, comparator_function_t cmp)
+{
+        assert(keys && hash_func && key_size > 0);
+        hash_map_t *map = hashmap_init(key_size, value_size, hash_func, cmp);
+        if (!map) return NULL;
+        /* With the table already sized for n elements, the
+           puts never have to redisperse */
+        if (hashmap_reserve(map, n) != GDS_SUCCESS
+            || hashmap_put_batch(map, keys, values, n) != GDS_SUCCESS)
+        {
+                hashmap_free(map);
+                return NULL;
+        }
+        return map;
+}
+
+int hashmap_put(hash_map_t *map, void *key, void *value){
+        assert(map && key);
+        if (map->value_size != 0)
+                assert(value);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        struct string_probe probe;
+        const void *k = __key_arg(map, key, &probe);
+        return __put(map, k, map->hash(k), value);
+}
+
+int hashmap_put_hashed(hash_map_t *map, void *key, hashcode_t hash, void *value){
+        assert(map && key && !map->strings);
+        if (map->value_size != 0)
+                assert(value);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        return __put(map, key, hash, value);
+}
+
+static void* __entry(hash_map_t *map, const void *key, hashcode_t hash, bool *inserted){
+        if (IS_READ_ONLY(map))
+                return NULL;
+        bool ins;
+        void *slot;
+        if (__find_or_insert(map, key, hash, &ins, &slot) != GDS_SUCCESS)
+                return NULL;
+        if (ins)
+                memset(slot_value(map, slot), 0, map->value_size);
+        if (inserted)
+                *inserted = ins;
+        return slot_value(map, slot);
+}
+
+void* hashmap_entry(hash_map_t *map, void *key, bool *inserted){
+        assert(map && key);
+        struct string_probe probe;
+        const void *k = __key_arg(map, key, &probe);
+        return __entry(map, k, map->hash(k), inserted);
+}
+
+void* hashmap_entry_hashed(hash_map_t *map, void *key, hashcode_t hash, bool *inserted){
+        assert(map && key && !map->strings);
+        return __entry(map, key, hash, inserted);
+}
+
+//// BATCH ////////////////////////////////////////////////////////////////////
+
+/*
+ * The batch functions work on groups of BATCH_SIZE keys. First, they
+ * hash every key of the group, and prefetch the control byte and the
+ * slot of its home position. Then, they resolve the keys one by one.
+ * By then, most of the memory they need is already on its way to the
+ * cache, so the cache misses of the group overlap instead of happening
+ * one after the other.
+ */
+#define BATCH_SIZE 16
+
+/**
+ * Hashes the keys and prefetches their home positions.
+ */
+static void __prefetch_group(const hash_map_t *map, const void *keys, size_t n, hashcode_t *hashes){
+        const struct table *t = &map->tab;
+        for (size_t i = 0; i < n; i++) {
+                hashes[i] = map->hash(void_offset(keys, i * map->key_size));
+                size_t pos = hashmap_get_pos(map, t, hashes[i], 0);
+                __builtin_prefetch(&t->ctrl[pos]);
+                __builtin_prefetch(slot_at(map, t, pos));
+        }
+}
+
+size_t hashmap_get_batch(const hash_map_t *map, const void *keys, size_t n, void *dests, bool *found){
+        assert(map && keys && dests);
+        hashcode_t hashes[BATCH_SIZE];
+        size_t n_found = 0;
+        if (map->strings) {
+                /* Hashing the strings dominates, so there's nothing to overlap */
+                for (size_t i = 0; i < n; i++) {
+                        void *key = void_offset(keys, i * map->key_size);
+                        bool f = hashmap_get(map, key, void_offset(dests, i * map->value_size)) != NULL;
+                        n_found += f;
+                        if (found)
+                                found[i] = f;
+                }
+                return n_found;
+        }
+        for (size_t start = 0; start < n; start += BATCH_SIZE) {
+                size_t len = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+                const void *group = void_offset(keys, start * map->key_size);
+                __prefetch_group(map, group, len, hashes);
+                for (size_t i = 0; i < len; i++) {
+                        bool in_old;
+                        const void *key = void_offset(group, i * map->key_size);
+                        ptrdiff_t pos = __lookup(map, key, hashes[i], &in_old, NULL);
+                        if (pos >= 0) {
+                                void *slot = slot_at(map, in_old ? &map->old : &map->tab, pos);
+                                memcpy(void_offset(dests, (start + i) * map->value_size),
+                                       slot_value(map, slot), map->value_size);
+                                n_found++;
+                        }
+                        if (found)
+                                found[start + i] = pos >= 0;
+                }
+        }
+        return n_found;
+}
+
+int hashmap_put_batch(hash_map_t *map, const void *keys, const void *values, size_t n){
+        assert(map && keys);
+        if (map->value_size != 0)
+                assert(values);
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        if (map->strings) {
+                for (size_t i = 0; i < n; i++) {
+                        void *value = map->value_size ? void_offset(values, i * map->value_size) : NULL;
+                        int status = hashmap_put(map, void_offset(keys, i * map->key_size), value);
+                        if (status != GDS_SUCCESS)
+                                return status;
+                }
+                return GDS_SUCCESS;
+        }
+        hashcode_t hashes[BATCH_SIZE];
+        for (size_t start = 0; start < n; start += BATCH_SIZE) {
+                size_t len = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+                const void *group = void_offset(keys, start * map->key_size);
+                __prefetch_group(map, group, len, hashes);
+                for (size_t i = 0; i < len; i++) {
+                        const void *value = map->value_size ? void_offset(values, (start + i) * map->value_size) : NULL;
+                        int status = __put(map, void_offset(group, i * map->key_size), hashes[i], value);
+                        if (status != GDS_SUCCESS)
+                                return status;
+                }
+        }
+        return GDS_SUCCESS;
+}
+
+//// GET_EXISTS ///////////////////////////////////////////////////////////////
+
+/**
+ * Returns a reference to the slot holding the key, or NULL.
+ */
+static void* __get_slot_hashed(const hash_map_t *map, const void *key, hashcode_t hash){
+        bool in_old;
+        ptrdiff_t pos = __lookup(map, key, hash, &in_old, NULL);
+        if (pos < 0)
+                return NULL;
+        return slot_at(map, in_old ? &map->old : &map->tab, pos);
+}
+
+static void* __get_slot(const hash_map_t *map, const void *key){
+        struct string_probe probe;
+        key = __key_arg(map, key, &probe);
+        return __get_slot_hashed(map, key, map->hash(key));
+}
+
+void* hashmap_get(const hash_map_t *map, void *key, void *dest){
+        assert(map && key);
+        void *slot = __get_slot(map, key);
+        if (!slot)
+                return NULL;
+        return memcpy(dest, slot_value(map, slot), map->value_size);
+}
+
+void* hashmap_get_ref(const hash_map_t *map, void *key){
+        assert(map && key);
+        void *slot = __get_slot(map, key);
+        return slot ? slot_value(map, slot) : NULL;
+}
+
+void* hashmap_get_ref_hashed(const hash_map_t *map, void *key, hashcode_t hash){
+        assert(map && key && !map->strings);
+        void *slot = __get_slot_hashed(map, key, hash);
+        return slot ? slot_value(map, slot) : NULL;
+}
+
+bool hashmap_exists(const hash_map_t *map, void *key){
+        assert(map && key);
+        return __get_slot(map, key) != NULL;
+}
+
+const void* hashmap_get_key(const hash_map_t *map, void *key){
+        assert(map && key);
+        void *slot = __get_slot(map, key);
+        return slot ? slot_key(map, slot) : NULL;
+}
+
+const void* hashmap_key_of_value(const hash_map_t *map, const void *value){
+        assert(map && value);
+        void *slot = (char*) value - map->value_offset;
+        return slot_key(map, slot);
+}
+
+static int __append_keys(const hash_map_t *map, const struct table *t, vector_t *v){
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (ctrl_is_full(t->ctrl[i])) {
+                        int status = vector_append(v, slot_key(map, slot_at(map, t, i)));
+                        if (status != GDS_SUCCESS)
+                                return status;
+                }
+        }
+        return GDS_SUCCESS;
+}
+
+vector_t* hashmap_keys(const hash_map_t *map) {
+        assert(map);
+        vector_t *v = vector_with_capacity(map->key_size, compare_equal, map->n_elements);
+        if (!v) return NULL;
+
+        if (__append_keys(map, &map->tab, v) != GDS_SUCCESS
+            || (IS_REHASHING(map) && __append_keys(map, &map->old, v) != GDS_SUCCESS))
+        {
+                vector_free(v);
+                return NULL;
         }
 
         return v;
 }
 
+/// ITERATOR //////////////////////////////////////////////////////////////////
+
+/*
+ * The iterator walks the control bytes of the current table, and
+ * then the ones of the old table, if the map is being rehashed.
+ * it->pos counts the slots of both tables, one after the other.
+ */
+
+hashmap_iterator_t hashmap_iterator(const hash_map_t *map){
+        assert(map);
+        return (hashmap_iterator_t) {
+                .map = map,
+                .pos = 0,
+        };
+}
+
+bool hashmap_it_next(hashmap_iterator_t *it, void **key_ref, void **value_ref){
+        assert(it);
+        const hash_map_t *map = it->map;
+        const struct table *t = &map->tab;
+        size_t pos = it->pos;
+        for (;;) {
+                if (pos >= t->capacity) {
+                        if (t != &map->tab || !IS_REHASHING(map)) {
+                                it->pos = SIZE_MAX;
+                                return false;
+                        }
+                        pos -= t->capacity;
+                        t = &map->old;
+                        continue;
+                }
+                if (ctrl_is_full(t->ctrl[pos]))
+                        break;
+                pos++;
+        }
+        void *slot = slot_at(map, t, pos);
+        if (key_ref)
+                *key_ref = slot_key(map, slot);
+        if (value_ref)
+                *value_ref = slot_value(map, slot);
+        it->pos = (t == &map->tab ? pos : pos + map->tab.capacity) + 1;
+        return true;
+}
+
+static void __foreach(const hash_map_t *map, const struct table *t, void (*func) (const void*,void*,void*), void *args){
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (ctrl_is_full(t->ctrl[i])) {
+                        void *slot = slot_at(map, t, i);
+                        func(slot_key(map, slot), slot_value(map, slot), args);
+                }
+        }
+}
+
+void hashmap_foreach(hash_map_t *map, void (*func) (const void*,void*,void*), void *args){
+        assert(map && func);
+        __foreach(map, &map->tab, func, args);
+        if (IS_REHASHING(map))
+                __foreach(map, &map->old, func, args);
+}
+
 /// REMOVE ////////////////////////////////////////////////////////////////////
 
-static int __delete_node(hash_map_t *map, size_t pos, bool redispersion, bool destroy){
-        hash_node_t node;
-        vector_at(map->vec_elements, pos, &node);
-        if (destroy && map->destructor)
-                map->destructor(node.value);
-        free(node.value);
-        free(node.key);
-        node.key = node.value = NULL;
-        node.state = DELETED;
-        vector_set_at(map->vec_elements, pos, &node);
+static int __delete_node(hash_map_t *map, struct table *t, size_t pos){
+        if (map->destructor)
+                map->destructor(slot_value(map, slot_at(map, t, pos)));
+        __erase(map, t, pos);
         map->n_elements--;
-        if (!redispersion)
+        if (IS_REHASHING(map))
                 return GDS_SUCCESS;
-        if (map->min_lf > 0 && LF(map->n_elements, VEC_SIZE(map)) <= map->min_lf){
-                size_t new_size = get_prev_size(VEC_SIZE(map));
-                int status = hashmap_redisperse(map, new_size);
+        if (map->min_lf > 0 && LF(map->n_elements, map->tab.capacity) <= map->min_lf){
+                size_t new_size = __shrink_size(map, map->tab.capacity);
+                if (new_size < map->tab.capacity)
+                        return __resize(map, new_size);
+        }
+        if (__needs_compaction(map))
+                __compact(map, &map->tab);
+        return GDS_SUCCESS;
+}
+
+size_t hashmap_retain(hash_map_t *map, bool (*pred) (const void*,void*,void*), void *args){
+        assert(map && pred);
+        if (IS_READ_ONLY(map) || __finish_rehash(map) != GDS_SUCCESS)
+                return 0;
+        struct table *t = &map->tab;
+        size_t removed = 0;
+        for (size_t i = 0; i < t->capacity; i++) {
+                /* With ROBIN_HOOD_HASHING, __erase shifts the next element
+                   into this slot, so we stay here until it's kept */
+                while (ctrl_is_full(t->ctrl[i])) {
+                        void *slot = slot_at(map, t, i);
+                        if (pred(slot_key(map, slot), slot_value(map, slot), args))
+                                break;
+                        if (map->destructor)
+                                map->destructor(slot_value(map, slot));
+                        __erase(map, t, i);
+                        map->n_elements--;
+                        removed++;
+                }
+        }
+
+        /* Shrink once at the end, instead of on every removal */
+        size_t new_size = t->capacity;
+        while (map->min_lf > 0 && LF(map->n_elements, new_size) <= map->min_lf
+               && __shrink_size(map, new_size) < new_size)
+                new_size = __shrink_size(map, new_size);
+        if (new_size < t->capacity && hashmap_redisperse(map, new_size) == GDS_SUCCESS)
+                return removed;
+        /* If there's no memory to shrink, at least get rid of the tombstones */
+        if (__needs_compaction(map))
+                __compact(map, &map->tab);
+        return removed;
+}
+
+static int __remove(hash_map_t *map, const void *key, hashcode_t hash){
+        if (IS_READ_ONLY(map))
+                return GDS_READ_ONLY_ERROR;
+        if (IS_REHASHING(map)) {
+                int status = __migrate(map, map->rehash_step);
                 if (status != GDS_SUCCESS)
                         return status;
         }
-        return GDS_SUCCESS;
+        bool in_old;
+        ptrdiff_t pos = __lookup(map, key, hash, &in_old, NULL);
+        if (pos < 0)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        return __delete_node(map, in_old ? &map->old : &map->tab, pos);
 }
 
 int hashmap_remove(hash_map_t *map, void *key){
         assert(map && key);
-        for (size_t i = 0; i < VEC_SIZE(map); i++){
-                size_t pos = hashmap_get_pos(map, key, i);
-                hash_node_t node;
-                vector_at(map->vec_elements, pos, &node);
-                if (node.state == FULL){
-                        if (__are_equal(map, key, node.key))
-                                return __delete_node(map, pos, true, true);
-                }
-                else if (node.state == EMPTY) break;
-        }
-        return GDS_ELEMENT_NOT_FOUND_ERROR;
+        struct string_probe probe;
+        const void *k = __key_arg(map, key, &probe);
+        return __remove(map, k, map->hash(k));
+}
+
+int hashmap_remove_hashed(hash_map_t *map, void *key, hashcode_t hash){
+        assert(map && key && !map->strings);
+        return __remove(map, key, hash);
 }
 
 size_t hashmap_length(const hash_map_t *map) {
@@ -429,12 +1651,370 @@ size_t hashmap_length(const hash_map_t *map) {
         return map->n_elements;
 }
 
+/// FREEZE ////////////////////////////////////////////////////////////////////
+
+/**
+ * Copies the keys and values of the table at the end of the arrays.
+ */
+static size_t __copy_pairs(const hash_map_t *map, const struct table *t, void *keys, void *values, size_t n){
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (!ctrl_is_full(t->ctrl[i]))
+                        continue;
+                void *slot = slot_at(map, t, i);
+                memcpy(void_offset(keys, n * map->key_size), slot_key(map, slot), map->key_size);
+                if (map->value_size)
+                        memcpy(void_offset(values, n * map->value_size), slot_value(map, slot), map->value_size);
+                n++;
+        }
+        return n;
+}
+
+frozen_hashmap_t* hashmap_freeze(const hash_map_t *map){
+        assert(map);
+        /* The frozen map would point to the strings of this one */
+        if (map->strings)
+                return NULL;
+        void *keys = gdsmalloc(map->n_elements * map->key_size + 1);
+        void *values = gdsmalloc(map->n_elements * map->value_size + 1);
+        frozen_hashmap_t *frozen = NULL;
+        if (keys && values) {
+                size_t n = __copy_pairs(map, &map->tab, keys, values, 0);
+                if (IS_REHASHING(map))
+                        n = __copy_pairs(map, &map->old, keys, values, n);
+                frozen = frozen_hashmap_from_arrays(keys, values, n, map->key_size, map->value_size, map->hash, map->cmp);
+        }
+        gdsfree(keys);
+        gdsfree(values);
+        return frozen;
+}
+
+/// SNAPSHOT //////////////////////////////////////////////////////////////////
+
+/*
+ * A snapshot file is a header followed by the memory block of the
+ * table, byte by byte. The table has no pointers (the control bytes
+ * are indexed like the slots), so it's position independent: once the
+ * file is mapped in memory, the lookups work on it directly.
+ *
+ * [ header | pad | slots | control bytes ]
+ *
+ * The table starts at a SNAPSHOT_ALIGN boundary, so the slots are
+ * properly aligned when the file is mapped at the start of a page.
+ * The header records everything the layout depends on, so a file
+ * written by another architecture is rejected instead of misread.
+ */
+#define SNAPSHOT_MAGIC "GDSHMAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+#define SNAPSHOT_ALIGN 64
+
+struct snapshot_header {
+        char magic[8];          ///< SNAPSHOT_MAGIC
+        u32 version;            ///< SNAPSHOT_VERSION
+        u32 byte_order;         ///< SNAPSHOT_BYTE_ORDER, as written by the machine that saved it
+        u32 hash_size;          ///< sizeof(hashcode_t)
+        u32 key_size;
+        u32 value_size;
+        u32 key_offset;
+        u32 value_offset;
+        u32 slot_size;
+        u32 redispersion;
+        u32 sizing;
+        u64 capacity;           ///< Number of slots of the table
+        u64 n_elements;
+        u64 n_deleted;          ///< Number of DELETED slots
+        u64 data_offset;        ///< Offset (in bytes) of the table inside the file
+};
+
+int hashmap_save(hash_map_t *map, const char *path){
+        assert(map && path);
+        if (map->strings)
+                return GDS_INVALID_PARAMETER_ERROR;
+        /* Only the current table is saved */
+        int status = __finish_rehash(map);
+        if (status != GDS_SUCCESS)
+                return status;
+
+        struct snapshot_header h = {
+                .version = SNAPSHOT_VERSION,
+                .byte_order = SNAPSHOT_BYTE_ORDER,
+                .hash_size = sizeof(hashcode_t),
+                .key_size = map->key_size,
+                .value_size = map->value_size,
+                .key_offset = map->key_offset,
+                .value_offset = map->value_offset,
+                .slot_size = map->slot_size,
+                .redispersion = map->redispersion,
+                .sizing = map->sizing,
+                .capacity = map->tab.capacity,
+                .n_elements = map->n_elements,
+                .n_deleted = map->tab.n_deleted,
+                .data_offset = align_up(sizeof(struct snapshot_header), SNAPSHOT_ALIGN),
+        };
+        memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+
+        FILE *f = fopen(path, "wb");
+        if (!f)
+                return GDS_ERROR;
+        static const u8 pad[SNAPSHOT_ALIGN] = {0};
+        size_t pad_size = h.data_offset - sizeof(h);
+        size_t bytes = __table_bytes(map, map->tab.capacity);
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+                  && fwrite(pad, 1, pad_size, f) == pad_size
+                  && fwrite(map->tab.slots, 1, bytes, f) == bytes;
+        ok = fclose(f) == 0 && ok;
+        return ok ? GDS_SUCCESS : GDS_ERROR;
+}
+
+/**
+ * Maps the whole file in memory, read only.
+ * Without mmap, the file is read into a heap buffer.
+ */
+static void* __map_image(const char *path, size_t *size){
+#ifdef USE_MMAP
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return NULL;
+        struct stat st;
+        void *image = NULL;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                *size = st.st_size;
+                image = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+                if (image == MAP_FAILED)
+                        image = NULL;
+        }
+        /* The mapping stays valid after closing the file */
+        close(fd);
+        return image;
+#else
+        FILE *f = fopen(path, "rb");
+        if (!f)
+                return NULL;
+        void *image = NULL;
+        long len;
+        if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+                *size = len;
+                image = gdsmalloc(*size);
+                if (image && fread(image, 1, *size, f) != *size) {
+                        gdsfree(image);
+                        image = NULL;
+                }
+        }
+        fclose(f);
+        return image;
+#endif
+}
+
+static void __unmap_image(void *image, size_t size){
+#ifdef USE_MMAP
+        munmap(image, size);
+#else
+        (void) size;
+        gdsfree(image);
+#endif
+}
+
+/**
+ * Checks that the header describes a table that fits in the
+ * image, with the same layout this machine would use.
+ */
+static bool __valid_header(const struct snapshot_header *h, size_t size){
+        if (size < sizeof(*h)
+            || memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0
+            || h->version != SNAPSHOT_VERSION
+            || h->byte_order != SNAPSHOT_BYTE_ORDER
+            || h->hash_size != sizeof(hashcode_t)
+            || h->key_size == 0 || h->key_size > UINT16_MAX || h->value_size > UINT16_MAX
+            || h->redispersion > ROBIN_HOOD_HASHING || h->sizing > POW2_SIZING
+            || h->capacity == 0 || h->n_elements > h->capacity
+            || h->n_deleted > h->capacity - h->n_elements
+            || h->data_offset % SNAPSHOT_ALIGN != 0 || h->data_offset > size)
+                return false;
+
+        hash_map_t layout = { .key_size = h->key_size, .value_size = h->value_size };
+        __init_layout(&layout);
+        if (layout.key_offset != h->key_offset
+            || layout.value_offset != h->value_offset
+            || layout.slot_size != h->slot_size)
+                return false;
+        if (h->sizing == POW2_SIZING && (h->capacity & (h->capacity - 1)) != 0)
+                return false;
+
+        size_t max_capacity = (SIZE_MAX - GROUP_WIDTH) / (h->slot_size + 1);
+        return h->capacity <= max_capacity
+               && __table_bytes(&layout, h->capacity) == size - h->data_offset;
+}
+
+hash_map_t* hashmap_open_mmap(const char *path, hash_function_t hash_func, comparator_function_t cmp){
+        assert(path && hash_func && cmp);
+        size_t size = 0;
+        void *image = __map_image(path, &size);
+        if (!image)
+                return NULL;
+        const struct snapshot_header *h = image;
+        hash_map_t *map = NULL;
+        if (!__valid_header(h, size) || !(map = gdsmalloc(sizeof(*map))))
+                goto error;
+
+        *map = (hash_map_t) {
+                .tab = {
+                        .slots = void_offset(image, h->data_offset),
+                        .ctrl = void_offset(image, h->data_offset + h->capacity * h->slot_size),
+                        .capacity = h->capacity,
+                        .n_deleted = h->n_deleted,
+                },
+                .hash = hash_func,
+                .cmp = cmp,
+                .n_elements = h->n_elements,
+                .value_size = h->value_size,
+                .key_size = h->key_size,
+                .key_offset = h->key_offset,
+                .value_offset = h->value_offset,
+                .slot_size = h->slot_size,
+                .max_lf = DICT_DEF_MAX_LF,
+                .min_lf = DICT_NO_SHRINKING,
+                .max_deleted = DICT_DEF_MAX_DELETED,
+                .redispersion = h->redispersion,
+                .sizing = h->sizing,
+                .image = image,
+                .image_size = size,
+        };
+
+        /* The positions depend on the stored hashes. If hash_func
+           doesn't return the same ones (for example, a seeded hash with
+           a different seed) every lookup would fail. Check the first key. */
+        for (size_t i = 0; i < map->tab.capacity; i++) {
+                if (ctrl_is_full(map->tab.ctrl[i])) {
+                        void *slot = slot_at(map, &map->tab, i);
+                        if (hash_func(slot_key(map, slot)) != *slot_hash(slot))
+                                goto error;
+                        break;
+                }
+        }
+        return map;
+
+error:
+        gdsfree(map);
+        __unmap_image(image, size);
+        return NULL;
+}
+
+bool hashmap_is_read_only(const hash_map_t *map){
+        assert(map);
+        return IS_READ_ONLY(map);
+}
+
+/// STATS /////////////////////////////////////////////////////////////////////
+
+/**
+ * Number of probes needed to find the element at the given position,
+ * counting the first one. With SWISS_HASHING, a probe checks a group.
+ */
+static size_t __probe_length(const hash_map_t *map, const struct table *t, size_t pos){
+        switch (map->redispersion) {
+        case LINEAR_HASHING:
+        case ROBIN_HOOD_HASHING:
+                return probe_distance(map, t, pos) + 1;
+        case SWISS_HASHING:
+                return probe_distance(map, t, pos) / GROUP_WIDTH + 1;
+        case QUADRATIC_HASHING:
+                break;
+        }
+        hashcode_t hash = *slot_hash(slot_at(map, t, pos));
+        size_t i = 0;
+        while (i < t->capacity && hashmap_get_pos(map, t, hash, i) != pos)
+                i++;
+        return i + 1;
+}
+
+static void __table_stats(const hash_map_t *map, const struct table *t, hashmap_stats_t *out, size_t *total_probes){
+        out->capacity += t->capacity;
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (t->ctrl[i] == CTRL_EMPTY) {
+                        out->n_empty++;
+                } else if (t->ctrl[i] == CTRL_DELETED) {
+                        out->n_deleted++;
+                } else {
+                        out->n_full++;
+                        size_t len = __probe_length(map, t, i);
+                        *total_probes += len;
+                        if (len > out->max_probe)
+                                out->max_probe = len;
+                        size_t bucket = len - 1 < HASHMAP_PROBE_HISTOGRAM ? len - 1 : HASHMAP_PROBE_HISTOGRAM - 1;
+                        out->probe_histogram[bucket]++;
+                }
+        }
+}
+
+static void __count_lengths(const hash_map_t *map, const struct table *t, size_t *counts){
+        for (size_t i = 0; i < t->capacity; i++) {
+                if (ctrl_is_full(t->ctrl[i]))
+                        counts[__probe_length(map, t, i)]++;
+        }
+}
+
+/**
+ * Computes the 99th percentile of the probe lengths.
+ * Most of the times, the histogram is enough. If the percentile falls
+ * in its last bucket, the lengths are counted again, one by one.
+ */
+static int __p99(const hash_map_t *map, hashmap_stats_t *out){
+        size_t target = out->n_full - out->n_full / 100;
+        size_t acc = 0;
+        for (size_t i = 0; i < HASHMAP_PROBE_HISTOGRAM - 1; i++) {
+                acc += out->probe_histogram[i];
+                if (acc >= target) {
+                        out->p99_probe = i + 1;
+                        return GDS_SUCCESS;
+                }
+        }
+        size_t *counts = gdscalloc(out->max_probe + 1, sizeof(size_t));
+        if (!counts)
+                return GDS_NOMEM_ERROR;
+        __count_lengths(map, &map->tab, counts);
+        if (IS_REHASHING(map))
+                __count_lengths(map, &map->old, counts);
+        size_t len = HASHMAP_PROBE_HISTOGRAM;
+        for (; len < out->max_probe; len++) {
+                acc += counts[len];
+                if (acc >= target)
+                        break;
+        }
+        out->p99_probe = len;
+        gdsfree(counts);
+        return GDS_SUCCESS;
+}
+
+int hashmap_stats(const hash_map_t *map, hashmap_stats_t *out){
+        assert(map && out);
+        *out = (hashmap_stats_t) {0};
+        size_t total_probes = 0;
+        __table_stats(map, &map->tab, out, &total_probes);
+        out->bytes = sizeof(*map);
+        if (map->strings)
+                out->bytes += arena_bytes(map->strings);
+        if (IS_READ_ONLY(map))
+                out->bytes += map->image_size;
+        else
+                out->bytes += __table_bytes(map, map->tab.capacity);
+        if (IS_REHASHING(map)) {
+                __table_stats(map, &map->old, out, &total_probes);
+                out->bytes += __table_bytes(map, map->old.capacity);
+        }
+        out->load_factor = LF(out->n_full, out->capacity);
+        out->n_redispersions = map->n_redispersions;
+        if (out->n_full == 0)
+                return GDS_SUCCESS;
+        out->avg_probe = (double) total_probes / out->n_full;
+        return __p99(map, out);
+}
+
 //// FREE //////////////////////////////////////////////////////////////////////
 
 static void __hashmap_free(hash_map_t *map){
         assert(map);
         hashmap_free_contents(map);
-        free(map);
+        gdsfree(map);
 }
 
 void (hashmap_free)(hash_map_t *d, ...){
@@ -451,10 +2031,23 @@ void (hashmap_free)(hash_map_t *d, ...){
 }
 
 void hashmap_clear(hash_map_t *map){
-        if (!map)
+        if (!map || IS_READ_ONLY(map))
                 return;
-        vector_map(map->vec_elements, free_node, &map->destructor);
-        vector_reset(map->vec_elements);
-        vector_resize(map->vec_elements, DICT_INITIAL_SIZE, init_node);
+        destroy_content(map, &map->tab);
+        if (IS_REHASHING(map)) {
+                destroy_content(map, &map->old);
+                gdsfree(map->old.slots);
+                map->old = (struct table) {0};
+                map->migrated = 0;
+        }
+        void *slots = map->tab.slots;
+        if (__alloc_table(map, &map->tab, __initial_size(map)) == GDS_SUCCESS)
+                gdsfree(slots);
+        else {
+                memset(map->tab.ctrl, CTRL_EMPTY, map->tab.capacity + GROUP_WIDTH);
+                map->tab.n_deleted = 0;
+        }
+        if (map->strings)
+                arena_clear(map->strings);
         map->n_elements = 0;
 }
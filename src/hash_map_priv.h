@@ -0,0 +1,35 @@
+/*
+ * hash_map_priv.h - Internal hash_map_t functions.
+ * Author: Saúl Valdelvira (2023)
+ */
+#ifndef __HASH_MAP_PRIV_H__
+#define __HASH_MAP_PRIV_H__
+
+#include "hash_map.h"
+
+/*
+ * Versions of the hashmap_ functions that take the hash of the key,
+ * for the structures built on top of a hash_map_t that need the hash
+ * for something else too (picking a shard, a frequency sketch...).
+ * This way, the key is only hashed once.
+ * The hash must be the one the map's hash function returns for the key.
+ * They don't work with maps of string keys.
+ */
+
+void* hashmap_get_ref_hashed(const hash_map_t *map, void *key, hashcode_t hash);
+
+int hashmap_put_hashed(hash_map_t *map, void *key, hashcode_t hash, void *value);
+
+void* hashmap_entry_hashed(hash_map_t *map, void *key, hashcode_t hash, bool *inserted);
+
+int hashmap_remove_hashed(hash_map_t *map, void *key, hashcode_t hash);
+
+/**
+ * Returns the key stored in the same slot as the value.
+ * For maps of string keys, this is a pointer to the map's copy.
+ * @param value a reference to a value of the map, returned by
+ *              hashmap_get_ref, hashmap_entry...
+ */
+const void* hashmap_key_of_value(const hash_map_t *map, const void *value);
+
+#endif /* __HASH_MAP_PRIV_H__ */
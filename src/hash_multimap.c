@@ -0,0 +1,401 @@
+/*
+ * hash_multimap.c - hash_multimap_t implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "hash_multimap.h"
+#include "hash_map.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The index maps every key to its chain of value blocks.
+ * The blocks live in a pool, and are referenced by their position in it,
+ * so the pool can grow with a realloc. A block starts with the link to
+ * the next block of the chain and the number of values in it, followed
+ * by the values:
+ *
+ * [ next | len | pad | value 0 | value 1 | ... ]
+ *
+ * A block is about BLOCK_TARGET bytes (a cache line), with at least one
+ * value. Values are always appended to the tail block, so every block of
+ * a chain but the last one is full. The blocks of removed keys are kept
+ * in a free list, linked by next.
+ */
+#define NIL UINT32_MAX
+#define BLOCK_TARGET 64
+#define POOL_INITIAL_BLOCKS 16
+
+struct block {
+        u32 next;
+        u32 len;
+};
+
+struct chain {
+        u32 head;
+        u32 tail;
+        size_t count;
+};
+
+struct hash_multimap {
+        hash_map_t *index;              ///< Maps the keys to their chain
+        void *blocks;                   ///< Pool of blocks
+        comparator_function_t cmp;      ///< Comparator function for the keys
+        destructor_function_t destructor;       ///< Destructor function pointer
+        size_t n_values;        ///< Total number of values
+        u32 n_blocks;           ///< Number of blocks of the pool ever used
+        u32 cap_blocks;         ///< Number of blocks the pool can hold
+        u32 free;               ///< First block of the free list
+        u32 block_values;       ///< Number of values in a block
+        u32 value_offset;       ///< Offset (in bytes) of the values inside a block
+        u32 block_size;         ///< Size (in bytes) of a block
+        size_t key_size;        ///< Size (in bytes) of the key data type
+        size_t value_size;      ///< Size (in bytes) of the value data type
+};
+
+/// BLOCKS /////////////////////////////////////////////////////////////////////
+
+__inline
+static struct block* block_at(const hash_multimap_t *map, u32 i){
+        return void_offset(map->blocks, (size_t) i * map->block_size);
+}
+
+__inline
+static void* block_value(const hash_multimap_t *map, u32 i, u32 pos){
+        return void_offset(block_at(map, i), map->value_offset + (size_t) pos * map->value_size);
+}
+
+/**
+ * Makes room in the pool for n more blocks
+ */
+static int __reserve_blocks(hash_multimap_t *map, size_t n){
+        size_t needed = (size_t) map->n_blocks + n;
+        if (needed <= map->cap_blocks)
+                return GDS_SUCCESS;
+        if (needed >= NIL)
+                return GDS_NOMEM_ERROR;
+        size_t cap = map->cap_blocks ? map->cap_blocks : POOL_INITIAL_BLOCKS;
+        while (cap < needed)
+                cap *= 2;
+        if (cap >= NIL)
+                cap = NIL - 1;
+        void *blocks = gdsrealloc(map->blocks, cap * map->block_size);
+        if (!blocks)
+                return GDS_NOMEM_ERROR;
+        map->blocks = blocks;
+        map->cap_blocks = cap;
+        return GDS_SUCCESS;
+}
+
+/**
+ * Takes an empty block from the free list or the pool.
+ * The pool must have room for it (see __reserve_blocks).
+ */
+static u32 __alloc_block(hash_multimap_t *map){
+        u32 i;
+        if (map->free != NIL) {
+                i = map->free;
+                map->free = block_at(map, i)->next;
+        } else {
+                assert(map->n_blocks < map->cap_blocks);
+                i = map->n_blocks++;
+        }
+        struct block *b = block_at(map, i);
+        b->next = NIL;
+        b->len = 0;
+        return i;
+}
+
+static void __release_chain(hash_multimap_t *map, u32 head, u32 tail){
+        block_at(map, tail)->next = map->free;
+        map->free = head;
+}
+
+static void __destroy_chain(hash_multimap_t *map, const struct chain *c){
+        if (!map->destructor)
+                return;
+        for (u32 i = c->head; i != NIL; i = block_at(map, i)->next) {
+                struct block *b = block_at(map, i);
+                for (u32 j = 0; j < b->len; j++)
+                        map->destructor(block_value(map, i, j));
+        }
+}
+
+/// INITIALIZE /////////////////////////////////////////////////////////////////
+
+hash_multimap_t* multimap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp){
+        assert(hash_func && cmp && key_size > 0);
+        if (value_size == 0 || value_size >= NIL)
+                return NULL;
+        hash_multimap_t *map = gdsmalloc(sizeof(*map));
+        if (!map) return NULL;
+        map->index = hashmap_init(key_size, sizeof(struct chain), hash_func, cmp);
+        if (!map->index) {
+                gdsfree(map);
+                return NULL;
+        }
+        map->key_size = key_size;
+        map->value_size = value_size;
+        map->cmp = cmp;
+        map->destructor = NULL;
+        map->blocks = NULL;
+        map->n_blocks = map->cap_blocks = 0;
+        map->free = NIL;
+        map->n_values = 0;
+
+        size_t value_align = align_of_size(value_size);
+        size_t block_align = _Alignof(struct block);
+        if (value_align > block_align)
+                block_align = value_align;
+        map->value_offset = align_up(sizeof(struct block), value_align);
+        size_t n = 1;
+        if (map->value_offset + value_size < BLOCK_TARGET)
+                n = (BLOCK_TARGET - map->value_offset) / value_size;
+        map->block_values = n;
+        map->block_size = align_up(map->value_offset + n * value_size, block_align);
+        return map;
+}
+
+void multimap_set_destructor(hash_multimap_t *map, destructor_function_t value_destructor){
+        if (map)
+                map->destructor = value_destructor;
+}
+
+/// PUT ////////////////////////////////////////////////////////////////////////
+
+int multimap_put_values(hash_multimap_t *map, void *key, const void *values, size_t n){
+        assert(map && key && values);
+        if (n == 0)
+                return GDS_SUCCESS;
+        bool inserted;
+        struct chain *c = hashmap_entry(map->index, key, &inserted);
+        if (!c)
+                return GDS_NOMEM_ERROR;
+
+        /* Reserve all the blocks first, so nothing fails once we start copying */
+        u32 room = 0;
+        if (!inserted)
+                room = map->block_values - block_at(map, c->tail)->len;
+        size_t new_blocks = 0;
+        if (n > room)
+                new_blocks = (n - room + map->block_values - 1) / map->block_values;
+        if (__reserve_blocks(map, new_blocks) != GDS_SUCCESS) {
+                if (inserted)
+                        hashmap_remove(map->index, key);
+                return GDS_NOMEM_ERROR;
+        }
+        if (inserted) {
+                c->head = c->tail = __alloc_block(map);
+                c->count = 0;
+        }
+
+        const byte *src = values;
+        size_t left = n;
+        while (left > 0) {
+                struct block *tail = block_at(map, c->tail);
+                if (tail->len == map->block_values) {
+                        u32 next = __alloc_block(map);
+                        block_at(map, c->tail)->next = next;
+                        c->tail = next;
+                        tail = block_at(map, next);
+                }
+                size_t run = map->block_values - tail->len;
+                if (run > left)
+                        run = left;
+                memcpy(block_value(map, c->tail, tail->len), src, run * map->value_size);
+                tail->len += run;
+                src += run * map->value_size;
+                left -= run;
+        }
+        c->count += n;
+        map->n_values += n;
+        return GDS_SUCCESS;
+}
+
+int multimap_put(hash_multimap_t *map, void *key, void *value){
+        assert(map && key && value);
+        return multimap_put_values(map, key, value, 1);
+}
+
+int multimap_put_batch(hash_multimap_t *map, const void *keys, const void *values, size_t n){
+        assert(map && keys && values);
+        size_t i = 0;
+        while (i < n) {
+                const void *key = void_offset(keys, i * map->key_size);
+                size_t run = 1;
+                while (i + run < n && map->cmp(key, void_offset(keys, (i + run) * map->key_size)) == 0)
+                        run++;
+                int status = multimap_put_values(map, (void*) key, void_offset(values, i * map->value_size), run);
+                if (status != GDS_SUCCESS)
+                        return status;
+                i += run;
+        }
+        return GDS_SUCCESS;
+}
+
+/// GET_EXISTS /////////////////////////////////////////////////////////////////
+
+size_t multimap_count(const hash_multimap_t *map, void *key){
+        assert(map && key);
+        struct chain *c = hashmap_get_ref(map->index, key);
+        return c ? c->count : 0;
+}
+
+bool multimap_exists(const hash_multimap_t *map, void *key){
+        assert(map && key);
+        return hashmap_exists(map->index, key);
+}
+
+size_t multimap_length(const hash_multimap_t *map){
+        assert(map);
+        return map->n_values;
+}
+
+size_t multimap_n_keys(const hash_multimap_t *map){
+        assert(map);
+        return hashmap_length(map->index);
+}
+
+/// RANGE //////////////////////////////////////////////////////////////////////
+
+multimap_range_t multimap_equal_range(const hash_multimap_t *map, void *key){
+        assert(map && key);
+        struct chain *c = hashmap_get_ref(map->index, key);
+        return (multimap_range_t) {
+                .map = map,
+                .block = c ? c->head : NIL,
+                .pos = 0,
+        };
+}
+
+void* multimap_range_next_run(multimap_range_t *range, size_t *n){
+        assert(range && n);
+        if (range->block == NIL) {
+                *n = 0;
+                return NULL;
+        }
+        const hash_multimap_t *map = range->map;
+        struct block *b = block_at(map, range->block);
+        void *run = block_value(map, range->block, range->pos);
+        *n = b->len - range->pos;
+        range->block = b->next;
+        range->pos = 0;
+        return run;
+}
+
+void* multimap_range_next(multimap_range_t *range){
+        assert(range);
+        if (range->block == NIL)
+                return NULL;
+        const hash_multimap_t *map = range->map;
+        struct block *b = block_at(map, range->block);
+        void *value = block_value(map, range->block, range->pos);
+        if (++range->pos == b->len) {
+                range->block = b->next;
+                range->pos = 0;
+        }
+        return value;
+}
+
+/// REMOVE /////////////////////////////////////////////////////////////////////
+
+int multimap_remove(hash_multimap_t *map, void *key){
+        assert(map && key);
+        struct chain *ref = hashmap_get_ref(map->index, key);
+        if (!ref)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        struct chain c = *ref;
+        hashmap_remove(map->index, key);
+        __destroy_chain(map, &c);
+        __release_chain(map, c.head, c.tail);
+        map->n_values -= c.count;
+        return GDS_SUCCESS;
+}
+
+int multimap_remove_value(hash_multimap_t *map, void *key, void *value){
+        assert(map && key && value);
+        struct chain *c = hashmap_get_ref(map->index, key);
+        if (!c)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        if (c->count == 1) {
+                if (memcmp(block_value(map, c->head, 0), value, map->value_size) != 0)
+                        return GDS_ELEMENT_NOT_FOUND_ERROR;
+                return multimap_remove(map, key);
+        }
+
+        void *found = NULL;
+        u32 before_tail = NIL;
+        for (u32 i = c->head; i != c->tail; i = block_at(map, i)->next) {
+                struct block *b = block_at(map, i);
+                for (u32 j = 0; !found && j < b->len; j++) {
+                        void *v = block_value(map, i, j);
+                        if (memcmp(v, value, map->value_size) == 0)
+                                found = v;
+                }
+                before_tail = i;
+        }
+        struct block *tail = block_at(map, c->tail);
+        for (u32 j = 0; !found && j < tail->len; j++) {
+                void *v = block_value(map, c->tail, j);
+                if (memcmp(v, value, map->value_size) == 0)
+                        found = v;
+        }
+        if (!found)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+
+        if (map->destructor)
+                map->destructor(found);
+        void *last = block_value(map, c->tail, tail->len - 1);
+        if (found != last)
+                memcpy(found, last, map->value_size);
+        if (--tail->len == 0) {
+                assert(before_tail != NIL);
+                __release_chain(map, c->tail, c->tail);
+                block_at(map, before_tail)->next = NIL;
+                c->tail = before_tail;
+        }
+        c->count--;
+        map->n_values--;
+        return GDS_SUCCESS;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+static void destroy_content(hash_multimap_t *map){
+        if (!map->destructor)
+                return;
+        hashmap_iterator_t it = hashmap_iterator(map->index);
+        void *c;
+        while (hashmap_it_next(&it, NULL, &c))
+                __destroy_chain(map, c);
+}
+
+void multimap_clear(hash_multimap_t *map){
+        if (!map)
+                return;
+        destroy_content(map);
+        hashmap_clear(map->index);
+        map->n_blocks = 0;
+        map->free = NIL;
+        map->n_values = 0;
+}
+
+void (multimap_free)(hash_multimap_t *map, ...){
+        if (!map)
+                return;
+        va_list arg;
+        va_start(arg, map);
+        do {
+                destroy_content(map);
+                hashmap_free(map->index);
+                gdsfree(map->blocks);
+                gdsfree(map);
+                map = va_arg(arg, hash_multimap_t*);
+        } while (map);
+        va_end(arg);
+}
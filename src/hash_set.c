@@ -0,0 +1,135 @@
+/*
+ * hash_set.c - Hash Set implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include <stdarg.h>
+#include <assert.h>
+#include "error.h"
+#include "hash_map.h"
+
+/*
+ * A hash set is a hash_map with no values. Its slots only
+ * hold the hash and the key, so there's no memory wasted.
+ * Like heap_t with vector_t, hashset_t is an alias of hash_map_t,
+ * to reuse its probing engine without an extra indirection.
+ */
+#define hashset_t hash_map_t
+#include "hash_set.h"
+
+/// INITIALIZE ////////////////////////////////////////////////////////////////
+
+hashset_t* hashset_init(size_t key_size, hash_function_t hash_func, comparator_function_t cmp){
+        assert(hash_func && cmp && key_size > 0);
+        return hashmap_init(key_size, 0, hash_func, cmp);
+}
+
+hashset_t* hashset_with_capacity(size_t key_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity){
+        assert(hash_func && cmp && key_size > 0);
+        return hashmap_with_capacity(key_size, 0, hash_func, cmp, capacity);
+}
+
+/// OPERATIONS ////////////////////////////////////////////////////////////////
+
+int hashset_add(hashset_t *set, void *key){
+        assert(set && key);
+        bool inserted;
+        if (!hashmap_entry(set, key, &inserted))
+                return GDS_ERROR;
+        return inserted ? GDS_SUCCESS : GDS_REPEATED_ELEMENT_ERROR;
+}
+
+bool hashset_contains(const hashset_t *set, void *key){
+        assert(set && key);
+        return hashmap_exists(set, key);
+}
+
+int hashset_remove(hashset_t *set, void *key){
+        assert(set && key);
+        return hashmap_remove(set, key);
+}
+
+size_t hashset_length(const hashset_t *set){
+        assert(set);
+        return hashmap_length(set);
+}
+
+vector_t* hashset_keys(const hashset_t *set){
+        assert(set);
+        return hashmap_keys(set);
+}
+
+/// BULK OPERATIONS ///////////////////////////////////////////////////////////
+
+/*
+ * The results start as a copy of one of the sets, which copies
+ * its table as it is, without hashing or probing. Then, the keys
+ * are added or filtered out.
+ */
+
+hashset_t* hashset_union(const hashset_t *a, const hashset_t *b){
+        assert(a && b);
+        if (hashmap_length(a) < hashmap_length(b)) {
+                const hashset_t *tmp = a;
+                a = b;
+                b = tmp;
+        }
+        hashset_t *result = hashmap_dup(a);
+        if (!result) return NULL;
+        hashmap_iterator_t it = hashmap_iterator(b);
+        void *key;
+        while (hashmap_it_next(&it, &key, NULL)) {
+                if (hashmap_put(result, key, NULL) != GDS_SUCCESS) {
+                        hashmap_free(result);
+                        return NULL;
+                }
+        }
+        return result;
+}
+
+static bool contained_in(const void *key, void *value, void *set){
+        (void) value;
+        return hashmap_exists(set, (void*) key);
+}
+
+static bool not_contained_in(const void *key, void *value, void *set){
+        return !contained_in(key, value, set);
+}
+
+hashset_t* hashset_intersection(const hashset_t *a, const hashset_t *b){
+        assert(a && b);
+        if (hashmap_length(a) > hashmap_length(b)) {
+                const hashset_t *tmp = a;
+                a = b;
+                b = tmp;
+        }
+        hashset_t *result = hashmap_dup(a);
+        if (!result) return NULL;
+        hashmap_retain(result, contained_in, (void*) b);
+        return result;
+}
+
+hashset_t* hashset_difference(const hashset_t *a, const hashset_t *b){
+        assert(a && b);
+        hashset_t *result = hashmap_dup(a);
+        if (!result) return NULL;
+        hashmap_retain(result, not_contained_in, (void*) b);
+        return result;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+void hashset_clear(hashset_t *set){
+        hashmap_clear(set);
+}
+
+void (hashset_free)(hashset_t *set, ...){
+        if (!set)
+                return;
+        va_list arg;
+        va_start(arg, set);
+        do {
+                hashmap_free(set);
+                set = va_arg(arg, hashset_t*);
+        } while (set);
+        va_end(arg);
+}
@@ -0,0 +1,104 @@
+/*
+ * interner.c - interner_t implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "interner.h"
+#include "hash_map.h"
+#include "hash_map_priv.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The ids are given by a hash_map with string keys, that maps
+ * every string to its id. The map keeps the copies of the strings
+ * in its arena, where they never move, so the array of strings by
+ * id just points to them.
+ */
+#define INITIAL_CAPACITY 16
+
+struct interner {
+        hash_map_t *ids;                ///< Maps the strings to their ids
+        const char **strings;           ///< The strings, by id
+        size_t n_strings;       ///< Number of strings interned
+        size_t capacity;        ///< Size of the strings array
+};
+
+interner_t* interner_init(void){
+        interner_t *interner = gdsmalloc(sizeof(*interner));
+        if (!interner) return NULL;
+        interner->ids = hashmap_init_string_keys(sizeof(size_t));
+        interner->strings = gdsmalloc(INITIAL_CAPACITY * sizeof(char*));
+        if (!interner->ids || !interner->strings) {
+                hashmap_free(interner->ids);
+                gdsfree(interner->strings);
+                gdsfree(interner);
+                return NULL;
+        }
+        interner->n_strings = 0;
+        interner->capacity = INITIAL_CAPACITY;
+        return interner;
+}
+
+size_t interner_intern(interner_t *interner, const char *str){
+        assert(interner && str);
+        bool inserted;
+        size_t *id = hashmap_entry(interner->ids, &str, &inserted);
+        if (!id)
+                return INTERNER_NOT_FOUND;
+        if (!inserted)
+                return *id;
+
+        if (interner->n_strings == interner->capacity) {
+                size_t capacity = interner->capacity * 2;
+                const char **strings = gdsrealloc(interner->strings, capacity * sizeof(char*));
+                if (!strings) {
+                        /* Undo the insertion, so the map and the array never disagree */
+                        hashmap_remove(interner->ids, &str);
+                        return INTERNER_NOT_FOUND;
+                }
+                interner->strings = strings;
+                interner->capacity = capacity;
+        }
+        *id = interner->n_strings;
+        const char *const *copy = hashmap_key_of_value(interner->ids, id);
+        interner->strings[interner->n_strings++] = *copy;
+        return *id;
+}
+
+size_t interner_find(const interner_t *interner, const char *str){
+        assert(interner && str);
+        size_t *id = hashmap_get_ref(interner->ids, &str);
+        return id ? *id : INTERNER_NOT_FOUND;
+}
+
+const char* interner_string(const interner_t *interner, size_t id){
+        assert(interner);
+        if (id >= interner->n_strings)
+                return NULL;
+        return interner->strings[id];
+}
+
+size_t interner_length(const interner_t *interner){
+        assert(interner);
+        return interner->n_strings;
+}
+
+void (interner_free)(interner_t *interner, ...){
+        if (!interner)
+                return;
+        va_list arg;
+        va_start(arg, interner);
+        do {
+                hashmap_free(interner->ids);
+                gdsfree(interner->strings);
+                gdsfree(interner);
+                interner = va_arg(arg, interner_t*);
+        } while (interner);
+        va_end(arg);
+}
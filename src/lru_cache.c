@@ -0,0 +1,325 @@
+/*
+ * lru_cache.c - LRU cache implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "lru_cache.h"
+#include "hash_map.h"
+#include "hash_map_priv.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The entries are stored in a pool of [capacity] entries, allocated
+ * when the cache is created. Each entry starts with the links of the
+ * recency list (as indices in the pool) and the hash of the key,
+ * followed by the key and the value inline:
+ *
+ * [ hash | prev | next | key | pad | value | pad ]
+ *
+ * The list goes from the most recently used entry (head) to the
+ * least recently used one (tail), which is the next to be evicted.
+ * The unused entries are kept in a free list, linked by next.
+ *
+ * The index maps every key to the position of its entry. It's
+ * reserved for [capacity] + 1 keys and never shrinks, so it doesn't
+ * allocate after the initialization: a new key is inserted in the
+ * index before the evicted one is removed, with a single probe.
+ * The index is always probed with the hash of the entry, so the key
+ * is hashed once per operation, and never again when it's evicted. It uses ROBIN_HOOD_HASHING,
+ * which doesn't leave DELETED marks behind, so the lookups don't
+ * get slower after lots of evictions.
+ */
+#define NIL UINT32_MAX
+
+struct lru_node {
+        hashcode_t hash;
+        u32 prev;
+        u32 next;
+};
+
+struct lru_cache {
+        void *entries;                  ///< Pool of entries
+        hash_map_t *index;              ///< Maps the keys to the position of their entry
+        hash_function_t hash;           ///< Hashing function pointer
+        destructor_function_t destructor;       ///< Destructor function pointer
+        lru_cache_stats_t stats;        ///< Hit, miss and eviction counters
+        u32 head;               ///< Most recently used entry
+        u32 tail;               ///< Least recently used entry
+        u32 free;               ///< First entry of the free list
+        u32 capacity;           ///< Number of entries in the pool
+        u32 n_entries;          ///< Number of entries in use
+        u16 key_size;           ///< Size (in bytes) of the key data type
+        u16 value_size;         ///< Size (in bytes) of the value data type
+        u32 key_offset;         ///< Offset (in bytes) of the key inside an entry
+        u32 value_offset;       ///< Offset (in bytes) of the value inside an entry
+        u32 entry_size;         ///< Size (in bytes) of an entry
+};
+
+/// ENTRIES ////////////////////////////////////////////////////////////////////
+
+__inline
+static struct lru_node* node_at(const lru_cache_t *cache, u32 i){
+        return void_offset(cache->entries, (size_t) i * cache->entry_size);
+}
+
+__inline
+static void* entry_key(const lru_cache_t *cache, u32 i){
+        return void_offset(node_at(cache, i), cache->key_offset);
+}
+
+__inline
+static void* entry_value(const lru_cache_t *cache, u32 i){
+        return void_offset(node_at(cache, i), cache->value_offset);
+}
+
+/// RECENCY LIST ///////////////////////////////////////////////////////////////
+
+static void __unlink(lru_cache_t *cache, u32 i){
+        struct lru_node *node = node_at(cache, i);
+        if (node->prev != NIL)
+                node_at(cache, node->prev)->next = node->next;
+        else
+                cache->head = node->next;
+        if (node->next != NIL)
+                node_at(cache, node->next)->prev = node->prev;
+        else
+                cache->tail = node->prev;
+}
+
+static void __push_front(lru_cache_t *cache, u32 i){
+        struct lru_node *node = node_at(cache, i);
+        node->prev = NIL;
+        node->next = cache->head;
+        if (cache->head != NIL)
+                node_at(cache, cache->head)->prev = i;
+        else
+                cache->tail = i;
+        cache->head = i;
+}
+
+/**
+ * Makes the entry the most recently used.
+ */
+static void __touch(lru_cache_t *cache, u32 i){
+        if (cache->head == i)
+                return;
+        __unlink(cache, i);
+        __push_front(cache, i);
+}
+
+static void __release(lru_cache_t *cache, u32 i){
+        node_at(cache, i)->next = cache->free;
+        cache->free = i;
+}
+
+/**
+ * Empties the recency list, and puts all the entries in the free list.
+ */
+static void __reset_entries(lru_cache_t *cache){
+        cache->head = cache->tail = NIL;
+        cache->free = NIL;
+        for (u32 i = cache->capacity; i > 0; i--)
+                __release(cache, i - 1);
+        cache->n_entries = 0;
+}
+
+/// INITIALIZE /////////////////////////////////////////////////////////////////
+
+lru_cache_t* lru_cache_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity){
+        assert(hash_func && cmp && key_size > 0);
+        if (capacity == 0 || capacity >= NIL)
+                return NULL;
+        lru_cache_t *cache = gdsmalloc(sizeof(*cache));
+        if (!cache) return NULL;
+        cache->key_size = key_size;
+        cache->value_size = value_size;
+        cache->capacity = capacity;
+        cache->hash = hash_func;
+        cache->destructor = NULL;
+        cache->stats = (lru_cache_stats_t) {0};
+
+        size_t key_align = align_of_size(key_size);
+        size_t value_align = align_of_size(value_size);
+        size_t entry_align = _Alignof(struct lru_node);
+        if (key_align > entry_align)
+                entry_align = key_align;
+        if (value_align > entry_align)
+                entry_align = value_align;
+        cache->key_offset = align_up(sizeof(struct lru_node), key_align);
+        cache->value_offset = align_up(cache->key_offset + key_size, value_align);
+        cache->entry_size = align_up(cache->value_offset + value_size, entry_align);
+
+        cache->entries = gdsmalloc(capacity * cache->entry_size);
+        cache->index = hashmap_init(key_size, sizeof(u32), hash_func, cmp);
+        if (!cache->entries || !cache->index
+            || hashmap_configure(cache->index, ROBIN_HOOD_HASHING, DICT_NO_SHRINKING, 0.0f) != GDS_SUCCESS
+            || hashmap_reserve(cache->index, (size_t) capacity + 1) != GDS_SUCCESS)
+        {
+                gdsfree(cache->entries);
+                hashmap_free(cache->index);
+                gdsfree(cache);
+                return NULL;
+        }
+        __reset_entries(cache);
+        return cache;
+}
+
+void lru_cache_set_destructor(lru_cache_t *cache, destructor_function_t value_destructor){
+        if (cache)
+                cache->destructor = value_destructor;
+}
+
+/// PUT ////////////////////////////////////////////////////////////////////////
+
+/**
+ * Removes the least recently used entry, and returns its position.
+ */
+static u32 __evict(lru_cache_t *cache){
+        u32 i = cache->tail;
+        hashmap_remove_hashed(cache->index, entry_key(cache, i), node_at(cache, i)->hash);
+        if (cache->destructor)
+                cache->destructor(entry_value(cache, i));
+        __unlink(cache, i);
+        cache->n_entries--;
+        cache->stats.evictions++;
+        return i;
+}
+
+int lru_cache_put(lru_cache_t *cache, void *key, void *value){
+        assert(cache && key);
+        if (cache->value_size != 0)
+                assert(value);
+        hashcode_t hash = cache->hash(key);
+        bool inserted;
+        u32 *pos = hashmap_entry_hashed(cache->index, key, hash, &inserted);
+        if (!pos)
+                return GDS_NOMEM_ERROR;
+        if (!inserted) {
+                void *dst = entry_value(cache, *pos);
+                if (cache->destructor)
+                        cache->destructor(dst);
+                if (cache->value_size)
+                        memcpy(dst, value, cache->value_size);
+                __touch(cache, *pos);
+                return GDS_SUCCESS;
+        }
+
+        u32 i;
+        if (cache->free != NIL) {
+                i = cache->free;
+                cache->free = node_at(cache, i)->next;
+                *pos = i;
+        } else {
+                /* Removing the evicted key can move the new slot,
+                 * but its value moves with it, so set it first */
+                *pos = cache->tail;
+                i = __evict(cache);
+        }
+        node_at(cache, i)->hash = hash;
+        memcpy(entry_key(cache, i), key, cache->key_size);
+        if (cache->value_size)
+                memcpy(entry_value(cache, i), value, cache->value_size);
+        __push_front(cache, i);
+        cache->n_entries++;
+        return GDS_SUCCESS;
+}
+
+/// GET_EXISTS /////////////////////////////////////////////////////////////////
+
+void* lru_cache_get_ref(lru_cache_t *cache, void *key){
+        assert(cache && key);
+        u32 *pos = hashmap_get_ref(cache->index, key);
+        if (!pos) {
+                cache->stats.misses++;
+                return NULL;
+        }
+        cache->stats.hits++;
+        __touch(cache, *pos);
+        return entry_value(cache, *pos);
+}
+
+void* lru_cache_get(lru_cache_t *cache, void *key, void *dest){
+        assert(cache && key && dest);
+        void *ref = lru_cache_get_ref(cache, key);
+        if (!ref)
+                return NULL;
+        return memcpy(dest, ref, cache->value_size);
+}
+
+bool lru_cache_exists(const lru_cache_t *cache, void *key){
+        assert(cache && key);
+        return hashmap_exists(cache->index, key);
+}
+
+size_t lru_cache_length(const lru_cache_t *cache){
+        assert(cache);
+        return cache->n_entries;
+}
+
+size_t lru_cache_capacity(const lru_cache_t *cache){
+        assert(cache);
+        return cache->capacity;
+}
+
+lru_cache_stats_t lru_cache_stats(const lru_cache_t *cache){
+        assert(cache);
+        return cache->stats;
+}
+
+/// REMOVE /////////////////////////////////////////////////////////////////////
+
+int lru_cache_remove(lru_cache_t *cache, void *key){
+        assert(cache && key);
+        hashcode_t hash = cache->hash(key);
+        u32 *pos = hashmap_get_ref_hashed(cache->index, key, hash);
+        if (!pos)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        u32 i = *pos;
+        hashmap_remove_hashed(cache->index, key, hash);
+        if (cache->destructor)
+                cache->destructor(entry_value(cache, i));
+        __unlink(cache, i);
+        __release(cache, i);
+        cache->n_entries--;
+        return GDS_SUCCESS;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+static void destroy_content(lru_cache_t *cache){
+        if (!cache->destructor)
+                return;
+        for (u32 i = cache->head; i != NIL; i = node_at(cache, i)->next)
+                cache->destructor(entry_value(cache, i));
+}
+
+void lru_cache_clear(lru_cache_t *cache){
+        if (!cache)
+                return;
+        destroy_content(cache);
+        hashmap_clear(cache->index);
+        /* hashmap_clear leaves the map with its initial size */
+        hashmap_reserve(cache->index, (size_t) cache->capacity + 1);
+        __reset_entries(cache);
+}
+
+void (lru_cache_free)(lru_cache_t *cache, ...){
+        if (!cache)
+                return;
+        va_list arg;
+        va_start(arg, cache);
+        do {
+                destroy_content(cache);
+                hashmap_free(cache->index);
+                gdsfree(cache->entries);
+                gdsfree(cache);
+                cache = va_arg(arg, lru_cache_t*);
+        } while (cache);
+        va_end(arg);
+}
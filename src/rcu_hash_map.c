@@ -0,0 +1,257 @@
+/*
+ * rcu_hash_map.c - Read-mostly hash map with lock free readers.
+ * Author: Saúl Valdelvira (2023)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "rcu_hash_map.h"
+#include "hash_map.h"
+#include "error.h"
+#include "gdsmalloc.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Grace periods are tracked with a global epoch counter.
+ * Every time a snapshot is replaced, the epoch is incremented
+ * and the old snapshot is retired with the new epoch. Every reader
+ * records the epoch it saw on its last quiescent state. A retired
+ * snapshot can be freed when all the readers have seen its epoch,
+ * since they all loaded the current pointer again after it was
+ * replaced.
+ */
+struct rcu_reader {
+        _Atomic uint64_t epoch;         ///< Epoch seen on the last quiescent state
+        struct rcu_reader *next;
+};
+
+struct retired {
+        hash_map_t *map;                ///< Old snapshot
+        uint64_t epoch;                 ///< Epoch in which it was replaced
+        struct retired *next;
+};
+
+struct rcu_hash_map {
+        _Atomic(hash_map_t*) current;   ///< Snapshot seen by the readers
+        _Atomic uint64_t epoch;         ///< Global epoch
+        pthread_mutex_t lock;           ///< Serializes writers, and protects the lists below
+        struct rcu_reader *readers;     ///< Registered readers
+        struct retired *retired;        ///< Snapshots waiting to be freed
+};
+
+/// INITIALIZE ////////////////////////////////////////////////////////////////
+
+rcu_hashmap_t* rcu_hashmap_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp){
+        assert(hash_func && key_size > 0);
+        rcu_hashmap_t *map = gdsmalloc(sizeof(*map));
+        if (!map) return NULL;
+        hash_map_t *snapshot = hashmap_init(key_size, value_size, hash_func, cmp);
+        if (!snapshot || pthread_mutex_init(&map->lock, NULL) != 0) {
+                hashmap_free(snapshot);
+                gdsfree(map);
+                return NULL;
+        }
+        atomic_init(&map->current, snapshot);
+        atomic_init(&map->epoch, 0);
+        map->readers = NULL;
+        map->retired = NULL;
+        return map;
+}
+
+/// RECLAIM ///////////////////////////////////////////////////////////////////
+
+/**
+ * Frees the retired snapshots that no reader can be using.
+ * Must be called with the lock held.
+ */
+static void __reclaim(rcu_hashmap_t *map){
+        uint64_t min = UINT64_MAX;
+        for (struct rcu_reader *r = map->readers; r; r = r->next) {
+                uint64_t e = atomic_load(&r->epoch);
+                if (e < min)
+                        min = e;
+        }
+        struct retired **it = &map->retired;
+        while (*it) {
+                struct retired *ret = *it;
+                if (ret->epoch <= min) {
+                        *it = ret->next;
+                        hashmap_free(ret->map);
+                        gdsfree(ret);
+                } else {
+                        it = &ret->next;
+                }
+        }
+}
+
+/**
+ * Replaces the current snapshot, and retires the old one.
+ * Must be called with the lock held.
+ */
+static int __publish(rcu_hashmap_t *map, hash_map_t *snapshot){
+        struct retired *ret = gdsmalloc(sizeof(*ret));
+        if (!ret)
+                return GDS_ERROR;
+        ret->map = atomic_exchange(&map->current, snapshot);
+        ret->epoch = atomic_fetch_add(&map->epoch, 1) + 1;
+        ret->next = map->retired;
+        map->retired = ret;
+        __reclaim(map);
+        return GDS_SUCCESS;
+}
+
+rcu_reader_t* rcu_hashmap_register_reader(rcu_hashmap_t *map){
+        assert(map);
+        rcu_reader_t *reader = gdsmalloc(sizeof(*reader));
+        if (!reader) return NULL;
+        pthread_mutex_lock(&map->lock);
+        atomic_init(&reader->epoch, atomic_load(&map->epoch));
+        reader->next = map->readers;
+        map->readers = reader;
+        pthread_mutex_unlock(&map->lock);
+        return reader;
+}
+
+void rcu_hashmap_unregister_reader(rcu_hashmap_t *map, rcu_reader_t *reader){
+        assert(map && reader);
+        pthread_mutex_lock(&map->lock);
+        for (rcu_reader_t **it = &map->readers; *it; it = &(*it)->next) {
+                if (*it == reader) {
+                        *it = reader->next;
+                        break;
+                }
+        }
+        gdsfree(reader);
+        __reclaim(map);
+        pthread_mutex_unlock(&map->lock);
+}
+
+void rcu_hashmap_quiescent(rcu_hashmap_t *map, rcu_reader_t *reader){
+        assert(map && reader);
+        atomic_store(&reader->epoch, atomic_load(&map->epoch));
+}
+
+void rcu_hashmap_synchronize(rcu_hashmap_t *map){
+        assert(map);
+        uint64_t target = atomic_load(&map->epoch);
+        for (;;) {
+                bool done = true;
+                pthread_mutex_lock(&map->lock);
+                for (struct rcu_reader *r = map->readers; r; r = r->next) {
+                        if (atomic_load(&r->epoch) < target) {
+                                done = false;
+                                break;
+                        }
+                }
+                __reclaim(map);
+                pthread_mutex_unlock(&map->lock);
+                if (done)
+                        return;
+                sched_yield();
+        }
+}
+
+/// READ //////////////////////////////////////////////////////////////////////
+
+/**
+ * Loads the current snapshot. This is the only synchronization
+ * in the read path.
+ */
+static inline hash_map_t* __snapshot(const rcu_hashmap_t *map){
+        return atomic_load_explicit(&((rcu_hashmap_t*) map)->current, memory_order_acquire);
+}
+
+const void* rcu_hashmap_get_ref(const rcu_hashmap_t *map, void *key){
+        assert(map && key);
+        return hashmap_get_ref(__snapshot(map), key);
+}
+
+void* rcu_hashmap_get(const rcu_hashmap_t *map, void *key, void *dest){
+        assert(map && key && dest);
+        return hashmap_get(__snapshot(map), key, dest);
+}
+
+bool rcu_hashmap_exists(const rcu_hashmap_t *map, void *key){
+        assert(map && key);
+        return hashmap_exists(__snapshot(map), key);
+}
+
+size_t rcu_hashmap_length(const rcu_hashmap_t *map){
+        assert(map);
+        return hashmap_length(__snapshot(map));
+}
+
+/// WRITE /////////////////////////////////////////////////////////////////////
+
+int rcu_hashmap_update(rcu_hashmap_t *map, int (*update) (hash_map_t *draft, void *ctx), void *ctx){
+        assert(map && update);
+        pthread_mutex_lock(&map->lock);
+        int status = GDS_ERROR;
+        hash_map_t *draft = hashmap_dup(atomic_load_explicit(&map->current, memory_order_relaxed));
+        if (!draft)
+                goto unlock;
+        status = update(draft, ctx);
+        if (status == GDS_SUCCESS)
+                status = __publish(map, draft);
+        if (status != GDS_SUCCESS)
+                hashmap_free(draft);
+unlock:
+        pthread_mutex_unlock(&map->lock);
+        return status;
+}
+
+struct kv {
+        void *key;
+        void *value;
+};
+
+static int __put(hash_map_t *draft, void *ctx){
+        struct kv *kv = ctx;
+        return hashmap_put(draft, kv->key, kv->value);
+}
+
+static int __remove(hash_map_t *draft, void *ctx){
+        struct kv *kv = ctx;
+        return hashmap_remove(draft, kv->key);
+}
+
+int rcu_hashmap_put(rcu_hashmap_t *map, void *key, void *value){
+        assert(map && key);
+        return rcu_hashmap_update(map, __put, &(struct kv){key, value});
+}
+
+int rcu_hashmap_remove(rcu_hashmap_t *map, void *key){
+        assert(map && key);
+        return rcu_hashmap_update(map, __remove, &(struct kv){key, NULL});
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+static void __rcu_hashmap_free(rcu_hashmap_t *map){
+        assert(!map->readers);
+        while (map->retired) {
+                struct retired *ret = map->retired;
+                map->retired = ret->next;
+                hashmap_free(ret->map);
+                gdsfree(ret);
+        }
+        hashmap_free(atomic_load(&map->current));
+        pthread_mutex_destroy(&map->lock);
+        gdsfree(map);
+}
+
+void (rcu_hashmap_free)(rcu_hashmap_t *map, ...){
+        if (!map)
+                return;
+        va_list arg;
+        va_start(arg, map);
+        do {
+                __rcu_hashmap_free(map);
+                map = va_arg(arg, rcu_hashmap_t*);
+        } while (map);
+        va_end(arg);
+}
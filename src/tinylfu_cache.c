@@ -0,0 +1,481 @@
+/*
+ * tinylfu_cache.c - W-TinyLFU cache implementation.
+ * Author: Saúl Valdelvira (2023)
+ */
+#include "tinylfu_cache.h"
+#include "hash_map.h"
+#include "hash_map_priv.h"
+#include "error.h"
+#include "definitions.h"
+#include "gdsmalloc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+/*
+ * The entries are stored like in lru_cache.c: a pool allocated once,
+ * with the links of a recency list inline, and a hash_map from the
+ * keys to their position in the pool. Every entry also keeps the
+ * hash of its key, so the key is hashed once, when it's put: the
+ * sketch and the index reuse it, even when the entry is evicted.
+ *
+ * [ hash | prev | next | region | key | pad | value | pad ]
+ *
+ * Every entry is in one of three LRU lists (regions):
+ * - WINDOW: where the new entries go. About 1% of the capacity.
+ * - PROBATION: entries admitted from the window into the main area.
+ * - PROTECTED: entries hit while in probation. About 80% of the main area.
+ *   When it's full, its least recently used entry goes back to probation.
+ *
+ * When an entry leaves the window and the main area is full, it competes
+ * with the least recently used entry of probation, and the one with the
+ * lowest estimated frequency is evicted.
+ *
+ * The pool has one entry more than the capacity, so a new entry
+ * can be put in the window before deciding which one to evict.
+ */
+#define NIL UINT32_MAX
+
+enum region {
+        WINDOW, PROBATION, PROTECTED, N_REGIONS
+};
+
+struct tlfu_node {
+        hashcode_t hash;
+        u32 prev;
+        u32 next;
+        u8 region;
+};
+
+struct tlfu_list {
+        u32 head;               ///< Most recently used entry
+        u32 tail;               ///< Least recently used entry
+        u32 len;                ///< Number of entries in the list
+};
+
+/*
+ * Count-min sketch of the access frequencies.
+ * It has SKETCH_DEPTH rows of 4 bit counters (two per byte). A key
+ * increments one counter on every row, and its frequency is the
+ * minimun of them, since the collisions can only make them bigger.
+ * After [sample_size] increments, all the counters are halved, so
+ * the keys that were popular a long time ago don't stay in the cache.
+ */
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX 15
+#define SKETCH_MIN_WIDTH 16
+#define SAMPLE_FACTOR 10
+
+struct sketch {
+        u8 *counters;           ///< SKETCH_DEPTH rows of [width] counters
+        size_t width;           ///< Number of counters per row. Always a power of two
+        size_t additions;       ///< Increments since the last reset
+        size_t sample_size;     ///< Increments before halving the counters
+};
+
+struct tinylfu_cache {
+        void *entries;                  ///< Pool of entries
+        hash_map_t *index;              ///< Maps the keys to the position of their entry
+        hash_function_t hash;           ///< Hashing function pointer
+        destructor_function_t destructor;       ///< Destructor function pointer
+        struct sketch sketch;           ///< Frequency sketch
+        struct tlfu_list lists[N_REGIONS];      ///< Recency list of every region
+        tinylfu_cache_stats_t stats;    ///< Hit, miss and eviction counters
+        u32 free;               ///< First entry of the free list
+        u32 capacity;           ///< Maximun number of entries
+        u32 window_cap;         ///< Maximun number of entries in the window
+        u32 main_cap;           ///< Maximun number of entries in probation + protected
+        u32 protected_cap;      ///< Maximun number of entries in protected
+        u32 n_entries;          ///< Number of entries in use
+        u16 key_size;           ///< Size (in bytes) of the key data type
+        u16 value_size;         ///< Size (in bytes) of the value data type
+        u32 key_offset;         ///< Offset (in bytes) of the key inside an entry
+        u32 value_offset;       ///< Offset (in bytes) of the value inside an entry
+        u32 entry_size;         ///< Size (in bytes) of an entry
+};
+
+/// ENTRIES ////////////////////////////////////////////////////////////////////
+
+__inline
+static struct tlfu_node* node_at(const tinylfu_cache_t *cache, u32 i){
+        return void_offset(cache->entries, (size_t) i * cache->entry_size);
+}
+
+__inline
+static void* entry_key(const tinylfu_cache_t *cache, u32 i){
+        return void_offset(node_at(cache, i), cache->key_offset);
+}
+
+__inline
+static void* entry_value(const tinylfu_cache_t *cache, u32 i){
+        return void_offset(node_at(cache, i), cache->value_offset);
+}
+
+/// SKETCH /////////////////////////////////////////////////////////////////////
+
+static int __sketch_init(struct sketch *s, size_t capacity){
+        s->width = SKETCH_MIN_WIDTH;
+        while (s->width < capacity)
+                s->width *= 2;
+        s->counters = gdsmalloc(SKETCH_DEPTH * s->width / 2);
+        if (!s->counters)
+                return GDS_ERROR;
+        memset(s->counters, 0, SKETCH_DEPTH * s->width / 2);
+        s->additions = 0;
+        s->sample_size = SAMPLE_FACTOR * capacity;
+        return GDS_SUCCESS;
+}
+
+/**
+ * Computes the position of the counter of the key in every row.
+ * The hash is mixed with hash_u64_mix, and the positions are derived
+ * from its two halves (a + i*b), so it's only mixed once.
+ */
+static void __sketch_positions(const struct sketch *s, hashcode_t hash, size_t pos[SKETCH_DEPTH]){
+        hashcode_t h = hash_u64_mix(&hash);
+        u32 a = h, b = (h >> 32) | 1;
+        for (u32 i = 0; i < SKETCH_DEPTH; i++)
+                pos[i] = i * s->width + ((a + i * b) & (s->width - 1));
+}
+
+__inline
+static u8 __counter(const struct sketch *s, size_t pos){
+        return (s->counters[pos / 2] >> (pos % 2 * 4)) & 0xF;
+}
+
+static u8 __sketch_frequency(const struct sketch *s, hashcode_t hash){
+        size_t pos[SKETCH_DEPTH];
+        __sketch_positions(s, hash, pos);
+        u8 freq = SKETCH_MAX;
+        for (int i = 0; i < SKETCH_DEPTH; i++) {
+                u8 c = __counter(s, pos[i]);
+                if (c < freq)
+                        freq = c;
+        }
+        return freq;
+}
+
+/**
+ * Halves all the counters. Both nibbles of
+ * a byte are shifted at once.
+ */
+static void __sketch_age(struct sketch *s){
+        for (size_t i = 0; i < SKETCH_DEPTH * s->width / 2; i++)
+                s->counters[i] = (s->counters[i] >> 1) & 0x77;
+        s->additions /= 2;
+}
+
+static void __sketch_increment(struct sketch *s, hashcode_t hash){
+        size_t pos[SKETCH_DEPTH];
+        __sketch_positions(s, hash, pos);
+        bool added = false;
+        for (int i = 0; i < SKETCH_DEPTH; i++) {
+                if (__counter(s, pos[i]) < SKETCH_MAX) {
+                        s->counters[pos[i] / 2] += 1 << (pos[i] % 2 * 4);
+                        added = true;
+                }
+        }
+        if (added && ++s->additions >= s->sample_size)
+                __sketch_age(s);
+}
+
+/// LISTS //////////////////////////////////////////////////////////////////////
+
+static void __unlink(tinylfu_cache_t *cache, u32 i){
+        struct tlfu_node *node = node_at(cache, i);
+        struct tlfu_list *list = &cache->lists[node->region];
+        if (node->prev != NIL)
+                node_at(cache, node->prev)->next = node->next;
+        else
+                list->head = node->next;
+        if (node->next != NIL)
+                node_at(cache, node->next)->prev = node->prev;
+        else
+                list->tail = node->prev;
+        list->len--;
+}
+
+static void __push_front(tinylfu_cache_t *cache, enum region region, u32 i){
+        struct tlfu_node *node = node_at(cache, i);
+        struct tlfu_list *list = &cache->lists[region];
+        node->region = region;
+        node->prev = NIL;
+        node->next = list->head;
+        if (list->head != NIL)
+                node_at(cache, list->head)->prev = i;
+        else
+                list->tail = i;
+        list->head = i;
+        list->len++;
+}
+
+static void __move_front(tinylfu_cache_t *cache, enum region region, u32 i){
+        __unlink(cache, i);
+        __push_front(cache, region, i);
+}
+
+static void __release(tinylfu_cache_t *cache, u32 i){
+        node_at(cache, i)->next = cache->free;
+        cache->free = i;
+}
+
+/**
+ * Empties the lists, and puts all the entries in the free list.
+ */
+static void __reset_entries(tinylfu_cache_t *cache){
+        for (int r = 0; r < N_REGIONS; r++)
+                cache->lists[r] = (struct tlfu_list) { NIL, NIL, 0 };
+        cache->free = NIL;
+        for (u32 i = cache->capacity + 1; i > 0; i--)
+                __release(cache, i - 1);
+        cache->n_entries = 0;
+}
+
+/// INITIALIZE /////////////////////////////////////////////////////////////////
+
+tinylfu_cache_t* tinylfu_cache_init(size_t key_size, size_t value_size, hash_function_t hash_func, comparator_function_t cmp, size_t capacity){
+        assert(hash_func && cmp && key_size > 0);
+        if (capacity == 0 || capacity >= NIL - 1)
+                return NULL;
+        tinylfu_cache_t *cache = gdsmalloc(sizeof(*cache));
+        if (!cache) return NULL;
+        cache->key_size = key_size;
+        cache->value_size = value_size;
+        cache->hash = hash_func;
+        cache->destructor = NULL;
+        cache->stats = (tinylfu_cache_stats_t) {0};
+        cache->capacity = capacity;
+        cache->window_cap = capacity / 100 > 0 ? capacity / 100 : 1;
+        cache->main_cap = capacity - cache->window_cap;
+        cache->protected_cap = cache->main_cap * 8 / 10;
+
+        size_t key_align = align_of_size(key_size);
+        size_t value_align = align_of_size(value_size);
+        size_t entry_align = _Alignof(struct tlfu_node);
+        if (key_align > entry_align)
+                entry_align = key_align;
+        if (value_align > entry_align)
+                entry_align = value_align;
+        cache->key_offset = align_up(sizeof(struct tlfu_node), key_align);
+        cache->value_offset = align_up(cache->key_offset + key_size, value_align);
+        cache->entry_size = align_up(cache->value_offset + value_size, entry_align);
+
+        cache->sketch.counters = NULL;
+        cache->entries = gdsmalloc((capacity + 1) * cache->entry_size);
+        cache->index = hashmap_init(key_size, sizeof(u32), hash_func, cmp);
+        if (!cache->entries || !cache->index
+            || __sketch_init(&cache->sketch, capacity) != GDS_SUCCESS
+            || hashmap_configure(cache->index, ROBIN_HOOD_HASHING, DICT_NO_SHRINKING, 0.0f) != GDS_SUCCESS
+            || hashmap_reserve(cache->index, capacity + 1) != GDS_SUCCESS)
+        {
+                gdsfree(cache->sketch.counters);
+                gdsfree(cache->entries);
+                hashmap_free(cache->index);
+                gdsfree(cache);
+                return NULL;
+        }
+        __reset_entries(cache);
+        return cache;
+}
+
+void tinylfu_cache_set_destructor(tinylfu_cache_t *cache, destructor_function_t value_destructor){
+        if (cache)
+                cache->destructor = value_destructor;
+}
+
+/// ACCESS /////////////////////////////////////////////////////////////////////
+
+/**
+ * Moves the entry to the front of its list. An entry hit
+ * while in probation is promoted to protected.
+ */
+static void __on_hit(tinylfu_cache_t *cache, u32 i){
+        switch (node_at(cache, i)->region) {
+        case WINDOW:
+                __move_front(cache, WINDOW, i);
+                break;
+        case PROTECTED:
+                __move_front(cache, PROTECTED, i);
+                break;
+        case PROBATION:
+                __move_front(cache, PROTECTED, i);
+                if (cache->lists[PROTECTED].len > cache->protected_cap)
+                        __move_front(cache, PROBATION, cache->lists[PROTECTED].tail);
+                break;
+        }
+}
+
+static void __evict(tinylfu_cache_t *cache, u32 i){
+        hashmap_remove_hashed(cache->index, entry_key(cache, i), node_at(cache, i)->hash);
+        if (cache->destructor)
+                cache->destructor(entry_value(cache, i));
+        __unlink(cache, i);
+        __release(cache, i);
+        cache->n_entries--;
+        cache->stats.evictions++;
+}
+
+/**
+ * If the window is over its capacity, its least recently used entry
+ * (the candidate) moves to the main area. If the main area is full,
+ * the candidate is only admitted if it's more frequent than the entry
+ * that probation would evict (the victim).
+ */
+static void __balance(tinylfu_cache_t *cache){
+        if (cache->lists[WINDOW].len <= cache->window_cap)
+                return;
+        u32 candidate = cache->lists[WINDOW].tail;
+        if (cache->lists[PROBATION].len + cache->lists[PROTECTED].len < cache->main_cap) {
+                __move_front(cache, PROBATION, candidate);
+                return;
+        }
+        if (cache->main_cap == 0) {
+                __evict(cache, candidate);
+                return;
+        }
+        /* The main area is full, and protected is smaller than it,
+           so probation can't be empty */
+        u32 victim = cache->lists[PROBATION].tail;
+        u8 candidate_freq = __sketch_frequency(&cache->sketch, node_at(cache, candidate)->hash);
+        u8 victim_freq = __sketch_frequency(&cache->sketch, node_at(cache, victim)->hash);
+        if (candidate_freq > victim_freq) {
+                __evict(cache, victim);
+                __move_front(cache, PROBATION, candidate);
+        } else {
+                __evict(cache, candidate);
+        }
+}
+
+int tinylfu_cache_put(tinylfu_cache_t *cache, void *key, void *value){
+        assert(cache && key);
+        if (cache->value_size != 0)
+                assert(value);
+        hashcode_t hash = cache->hash(key);
+        bool inserted;
+        u32 *pos = hashmap_entry_hashed(cache->index, key, hash, &inserted);
+        if (!pos)
+                return GDS_NOMEM_ERROR;
+        __sketch_increment(&cache->sketch, hash);
+        if (!inserted) {
+                void *dst = entry_value(cache, *pos);
+                if (cache->destructor)
+                        cache->destructor(dst);
+                if (cache->value_size)
+                        memcpy(dst, value, cache->value_size);
+                __on_hit(cache, *pos);
+                return GDS_SUCCESS;
+        }
+
+        /* There's always a free entry, since the pool has capacity + 1.
+           The index is set before __balance, which can move its slot */
+        u32 i = cache->free;
+        cache->free = node_at(cache, i)->next;
+        *pos = i;
+        node_at(cache, i)->hash = hash;
+        memcpy(entry_key(cache, i), key, cache->key_size);
+        if (cache->value_size)
+                memcpy(entry_value(cache, i), value, cache->value_size);
+        __push_front(cache, WINDOW, i);
+        cache->n_entries++;
+        __balance(cache);
+        return GDS_SUCCESS;
+}
+
+void* tinylfu_cache_get_ref(tinylfu_cache_t *cache, void *key){
+        assert(cache && key);
+        hashcode_t hash = cache->hash(key);
+        __sketch_increment(&cache->sketch, hash);
+        u32 *pos = hashmap_get_ref_hashed(cache->index, key, hash);
+        if (!pos) {
+                cache->stats.misses++;
+                return NULL;
+        }
+        cache->stats.hits++;
+        __on_hit(cache, *pos);
+        return entry_value(cache, *pos);
+}
+
+void* tinylfu_cache_get(tinylfu_cache_t *cache, void *key, void *dest){
+        assert(cache && key && dest);
+        void *ref = tinylfu_cache_get_ref(cache, key);
+        if (!ref)
+                return NULL;
+        return memcpy(dest, ref, cache->value_size);
+}
+
+bool tinylfu_cache_exists(const tinylfu_cache_t *cache, void *key){
+        assert(cache && key);
+        return hashmap_exists(cache->index, key);
+}
+
+size_t tinylfu_cache_length(const tinylfu_cache_t *cache){
+        assert(cache);
+        return cache->n_entries;
+}
+
+size_t tinylfu_cache_capacity(const tinylfu_cache_t *cache){
+        assert(cache);
+        return cache->capacity;
+}
+
+tinylfu_cache_stats_t tinylfu_cache_stats(const tinylfu_cache_t *cache){
+        assert(cache);
+        return cache->stats;
+}
+
+/// REMOVE /////////////////////////////////////////////////////////////////////
+
+int tinylfu_cache_remove(tinylfu_cache_t *cache, void *key){
+        assert(cache && key);
+        hashcode_t hash = cache->hash(key);
+        u32 *pos = hashmap_get_ref_hashed(cache->index, key, hash);
+        if (!pos)
+                return GDS_ELEMENT_NOT_FOUND_ERROR;
+        u32 i = *pos;
+        hashmap_remove_hashed(cache->index, key, hash);
+        if (cache->destructor)
+                cache->destructor(entry_value(cache, i));
+        __unlink(cache, i);
+        __release(cache, i);
+        cache->n_entries--;
+        return GDS_SUCCESS;
+}
+
+//// FREE //////////////////////////////////////////////////////////////////////
+
+static void destroy_content(tinylfu_cache_t *cache){
+        if (!cache->destructor)
+                return;
+        for (int r = 0; r < N_REGIONS; r++) {
+                for (u32 i = cache->lists[r].head; i != NIL; i = node_at(cache, i)->next)
+                        cache->destructor(entry_value(cache, i));
+        }
+}
+
+void tinylfu_cache_clear(tinylfu_cache_t *cache){
+        if (!cache)
+                return;
+        destroy_content(cache);
+        hashmap_clear(cache->index);
+        /* hashmap_clear leaves the map with its initial size */
+        hashmap_reserve(cache->index, cache->capacity + 1);
+        __reset_entries(cache);
+}
+
+void (tinylfu_cache_free)(tinylfu_cache_t *cache, ...){
+        if (!cache)
+                return;
+        va_list arg;
+        va_start(arg, cache);
+        do {
+                destroy_content(cache);
+                hashmap_free(cache->index);
+                gdsfree(cache->sketch.counters);
+                gdsfree(cache->entries);
+                gdsfree(cache);
+                cache = va_arg(arg, tinylfu_cache_t*);
+        } while (cache);
+        va_end(arg);
+}
@@ -0,0 +1,117 @@
+#include "../include/concurrent_hash_map.h"
+#include "hash.h"
+#include "test.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_THREADS 8
+#define PER_THREAD 5000
+
+static concurrent_hashmap_t *map;
+
+void test_simple(void){
+        map = concurrent_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int, 0);
+        assert(map);
+        int key = 1, value = 2, dest;
+        assert(concurrent_hashmap_put(map, &key, &value) == GDS_SUCCESS);
+        assert(concurrent_hashmap_exists(map, &key));
+        assert(concurrent_hashmap_get(map, &key, &dest) && dest == 2);
+        assert(concurrent_hashmap_remove(map, &key) == GDS_SUCCESS);
+        assert(!concurrent_hashmap_exists(map, &key));
+        assert(concurrent_hashmap_remove(map, &key) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        concurrent_hashmap_free(map);
+}
+
+static void* put_range(void *arg){
+        int start = *(int*) arg;
+        for (int i = start; i < start + PER_THREAD; i++)
+                assert(concurrent_hashmap_put(map, &i, &(int){i * 2}) == GDS_SUCCESS);
+        for (int i = start; i < start + PER_THREAD; i += 2)
+                assert(concurrent_hashmap_remove(map, &i) == GDS_SUCCESS);
+        return NULL;
+}
+
+void parallel_test(void){
+        test_step("Parallel put/remove");
+        map = concurrent_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int, 16);
+        pthread_t threads[N_THREADS];
+        int starts[N_THREADS];
+        for (int i = 0; i < N_THREADS; i++) {
+                starts[i] = i * PER_THREAD;
+                pthread_create(&threads[i], NULL, put_range, &starts[i]);
+        }
+        for (int i = 0; i < N_THREADS; i++)
+                pthread_join(threads[i], NULL);
+
+        assert(concurrent_hashmap_length(map) == N_THREADS * PER_THREAD / 2);
+        for (int i = 0; i < N_THREADS * PER_THREAD; i++) {
+                int v;
+                if (i % 2 == 0) {
+                        assert(!concurrent_hashmap_get(map, &i, &v));
+                } else {
+                        assert(concurrent_hashmap_get(map, &i, &v));
+                        assert(v == i * 2);
+                }
+        }
+        concurrent_hashmap_free(map);
+        test_ok();
+}
+
+static int compute_calls = 0;
+static pthread_mutex_t compute_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int compute(const void *key, void *value, void *ctx){
+        (void) ctx;
+        pthread_mutex_lock(&compute_lock);
+        compute_calls++;
+        pthread_mutex_unlock(&compute_lock);
+        *(int*) value = *(int*) key + 1;
+        return GDS_SUCCESS;
+}
+
+static void* upsert(void *arg){
+        int *inserted = arg;
+        for (int i = 0; i < PER_THREAD; i++) {
+                int v;
+                bool ins;
+                assert(concurrent_hashmap_compute_if_absent(map, &i, &v, compute, NULL, &ins) == GDS_SUCCESS);
+                assert(v == i + 1);
+                *inserted += ins;
+        }
+        return NULL;
+}
+
+void compute_if_absent_test(void){
+        test_step("Compute if absent");
+        map = concurrent_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int, 4);
+        pthread_t threads[N_THREADS];
+        int inserted[N_THREADS] = {0};
+        for (int i = 0; i < N_THREADS; i++)
+                pthread_create(&threads[i], NULL, upsert, &inserted[i]);
+        int total = 0;
+        for (int i = 0; i < N_THREADS; i++) {
+                pthread_join(threads[i], NULL);
+                total += inserted[i];
+        }
+        /* Every key is computed and inserted exactly once */
+        assert(total == PER_THREAD);
+        assert(compute_calls == PER_THREAD);
+        assert(concurrent_hashmap_length(map) == PER_THREAD);
+
+        concurrent_hashmap_clear(map);
+        assert(concurrent_hashmap_length(map) == 0);
+        concurrent_hashmap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("concurrent_hash_map.c");
+
+        test_simple();
+        parallel_test();
+        compute_if_absent_test();
+
+        test_end("concurrent_hash_map.c");
+        return 0;
+}
@@ -0,0 +1,112 @@
+#include "../include/cuckoo_hash_map.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        cuckoo_hashmap_t *map = cuckoo_hashmap_init(sizeof(int), sizeof(char), hash_u32_mix, compare_int);
+        assert(map);
+        int key = 1;
+        char c = 'A', dest;
+        assert(cuckoo_hashmap_put(map, &key, &c) == GDS_SUCCESS);
+        assert(cuckoo_hashmap_exists(map, &key));
+        assert(cuckoo_hashmap_get(map, &key, &dest) && dest == 'A');
+        assert(cuckoo_hashmap_remove(map, &key) == GDS_SUCCESS);
+        assert(!cuckoo_hashmap_exists(map, &key));
+        assert(!cuckoo_hashmap_get(map, &key, &dest));
+        assert(cuckoo_hashmap_remove(map, &key) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        cuckoo_hashmap_free(map);
+}
+
+void brute(void){
+        test_step("Brute");
+        const int n = 100000;
+        cuckoo_hashmap_t *map = cuckoo_hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+        for (int i = 0; i < n; i++)
+                assert(cuckoo_hashmap_put(map, &i, &(int){i * 2}) == GDS_SUCCESS);
+        assert(cuckoo_hashmap_length(map) == (size_t) n);
+        for (int i = 0; i < n; i++)
+                assert(*(int*) cuckoo_hashmap_get_ref(map, &i) == i * 2);
+        for (int i = 0; i < n; i += 3)
+                assert(cuckoo_hashmap_remove(map, &i) == GDS_SUCCESS);
+        for (int i = 0; i < n; i++)
+                assert(cuckoo_hashmap_exists(map, &i) == (i % 3 != 0));
+        cuckoo_hashmap_clear(map);
+        assert(cuckoo_hashmap_length(map) == 0);
+        assert(!cuckoo_hashmap_exists(map, &(int){1}));
+        cuckoo_hashmap_free(map);
+        test_ok();
+}
+
+/* Random puts and removes, checked against a plain array */
+void random_test(void){
+        test_step("Random");
+        const int n = 2048;
+        int *ref = malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++)
+                ref[i] = -1;
+        /* Small capacity, so the evictions and the growth are exercised */
+        cuckoo_hashmap_t *map = cuckoo_hashmap_with_capacity(sizeof(int), sizeof(int), hash_u32_mix, compare_int, 8);
+        size_t len = 0;
+        for (int it = 0; it < 50000; it++) {
+                int k = rand() % n;
+                if (rand() % 3) {
+                        assert(cuckoo_hashmap_put(map, &k, &it) == GDS_SUCCESS);
+                        if (ref[k] < 0)
+                                len++;
+                        ref[k] = it;
+                } else {
+                        int status = cuckoo_hashmap_remove(map, &k);
+                        assert(status == (ref[k] < 0 ? GDS_ELEMENT_NOT_FOUND_ERROR : GDS_SUCCESS));
+                        if (ref[k] >= 0)
+                                len--;
+                        ref[k] = -1;
+                }
+                assert(cuckoo_hashmap_length(map) == len);
+        }
+        for (int i = 0; i < n; i++) {
+                int *v = cuckoo_hashmap_get_ref(map, &i);
+                if (ref[i] < 0)
+                        assert(!v);
+                else
+                        assert(v && *v == ref[i]);
+        }
+        cuckoo_hashmap_free(map);
+        free(ref);
+        test_ok();
+}
+
+static void free_str(void *arg){
+        free(*(char**) arg);
+}
+
+void destructor_test(void){
+        test_step("Destructor");
+        cuckoo_hashmap_t *map = cuckoo_hashmap_init(sizeof(int), sizeof(char*), hash_u32_mix, compare_int);
+        cuckoo_hashmap_set_destructor(map, free_str);
+        for (int i = 0; i < 100; i++) {
+                char *str = malloc(8);
+                strcpy(str, "value");
+                assert(cuckoo_hashmap_put(map, &i, &str) == GDS_SUCCESS);
+        }
+        /* Overwriting and removing call the destructor */
+        char *str = malloc(8);
+        assert(cuckoo_hashmap_put(map, &(int){0}, &str) == GDS_SUCCESS);
+        assert(cuckoo_hashmap_remove(map, &(int){1}) == GDS_SUCCESS);
+        cuckoo_hashmap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("cuckoo_hash_map.c");
+
+        test_simple();
+        brute();
+        random_test();
+        destructor_test();
+
+        test_end("cuckoo_hash_map.c");
+        return 0;
+}
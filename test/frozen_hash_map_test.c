@@ -0,0 +1,109 @@
+#include "../include/frozen_hash_map.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        int keys[] = { 7, 42, -3, 1000 };
+        char values[] = { 'a', 'b', 'c', 'd' };
+        frozen_hashmap_t *map = frozen_hashmap_from_arrays(keys, values, 4, sizeof(int), sizeof(char), hash_u32_mix, compare_int);
+        assert(map);
+        assert(frozen_hashmap_length(map) == 4);
+        char c;
+        for (int i = 0; i < 4; i++)
+                assert(frozen_hashmap_get(map, &keys[i], &c) && c == values[i]);
+        assert(!frozen_hashmap_exists(map, &(int){8}));
+        assert(!frozen_hashmap_get(map, &(int){0}, &c));
+        frozen_hashmap_free(map);
+
+        /* Empty map */
+        map = frozen_hashmap_from_arrays(keys, values, 0, sizeof(int), sizeof(char), hash_u32_mix, compare_int);
+        assert(map && frozen_hashmap_length(map) == 0);
+        assert(!frozen_hashmap_exists(map, &keys[0]));
+        frozen_hashmap_free(map);
+
+        /* Repeated keys */
+        int repeated[] = { 1, 2, 3, 2 };
+        assert(!frozen_hashmap_from_arrays(repeated, values, 4, sizeof(int), sizeof(char), hash_u32_mix, compare_int));
+}
+
+void brute(void){
+        test_step("Brute");
+        for (int n = 1; n <= 200000; n *= 7) {
+                long *keys = malloc(n * sizeof(long));
+                int *values = malloc(n * sizeof(int));
+                for (int i = 0; i < n; i++) {
+                        keys[i] = (long) i * 2;
+                        values[i] = i;
+                }
+                frozen_hashmap_t *map = frozen_hashmap_from_arrays(keys, values, n, sizeof(long), sizeof(int), hash_u64_mix, compare_long);
+                assert(map);
+                for (int i = 0; i < n; i++) {
+                        const int *v = frozen_hashmap_get_ref(map, &keys[i]);
+                        assert(v && *v == i);
+                        /* The odd keys are not in the map */
+                        assert(!frozen_hashmap_exists(map, &(long){keys[i] + 1}));
+                }
+                frozen_hashmap_free(map);
+                free(keys);
+                free(values);
+        }
+        test_ok();
+}
+
+static int compare_str_ptr(const void *e_1, const void *e_2){
+        return strcmp(* (char**) e_1, * (char**) e_2);
+}
+
+void freeze_test(void){
+        test_step("Freeze");
+        const int n = 50000;
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(long), hash_int, compare_int);
+        hashmap_set_incremental_rehash(map, 4);
+        for (int i = 0; i < n; i++)
+                hashmap_put(map, &i, &(long){i * 10L});
+        for (int i = 0; i < n; i += 5)
+                hashmap_remove(map, &i);
+
+        frozen_hashmap_t *frozen = hashmap_freeze(map);
+        assert(frozen);
+        assert(frozen_hashmap_length(frozen) == hashmap_length(map));
+        for (int i = 0; i < n; i++) {
+                const long *v = frozen_hashmap_get_ref(frozen, &i);
+                if (i % 5 == 0)
+                        assert(!v);
+                else
+                        assert(v && *v == i * 10L);
+        }
+        frozen_hashmap_free(frozen);
+        hashmap_free(map);
+
+        /* String keys, with no values */
+        char *words[] = { "apple", "banana", "cherry", "date", "elderberry" };
+        map = hashmap_init(sizeof(char*), 0, hash_string_fast, compare_str_ptr);
+        for (int i = 0; i < 5; i++)
+                hashmap_put(map, &words[i], NULL);
+        frozen = hashmap_freeze(map);
+        for (int i = 0; i < 5; i++) {
+                char buf[16];
+                char *copy = strcpy(buf, words[i]);
+                assert(frozen_hashmap_exists(frozen, &copy));
+        }
+        assert(!frozen_hashmap_exists(frozen, &(char*){"fig"}));
+        frozen_hashmap_free(frozen);
+        hashmap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("frozen_hash_map.c");
+
+        test_simple();
+        brute();
+        freeze_test();
+
+        test_end("frozen_hash_map.c");
+        return 0;
+}
@@ -1,4 +1,6 @@
 #include "../include/hash_map.h"
+#include "../include/frozen_hash_map.h"
+#include "../include/allocator.h"
 #include "hash.h"
 #include "test.h"
 #include <stdio.h>
@@ -50,6 +52,28 @@ void config(void){
 
         hashmap_free(dic);
 
+        /* -1 keeps the current redispersion, and the map stays usable */
+        const char *path = "hash_map_config.snapshot";
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(hashmap_configure(map, SWISS_HASHING, 0.0f, 0.0f) == GDS_SUCCESS);
+        for (int i = 0; i < 1000; i++)
+                hashmap_put(map, &(int){i * 1009}, &i);
+        assert(hashmap_configure(map, -1, DICT_NO_SHRINKING, 0.0f) == GDS_SUCCESS);
+        assert(hashmap_configure(map, DICT_KEEP_REDISPERSION, 0.0f, 0.0f) == GDS_SUCCESS);
+        assert(hashmap_configure(map, ROBIN_HOOD_HASHING + 1, 0.0f, 0.0f) == GDS_INVALID_PARAMETER_ERROR);
+        for (int i = 1000; i < 2000; i++)
+                assert(hashmap_put(map, &(int){i * 1009}, &i) == GDS_SUCCESS);
+        for (int i = 0; i < 2000; i++) {
+                int v;
+                assert(hashmap_get(map, &(int){i * 1009}, &v) && v == i);
+        }
+        assert(hashmap_save(map, path) == GDS_SUCCESS);
+        hashmap_free(map);
+        map = hashmap_open_mmap(path, hash_int, compare_int);
+        assert(map && hashmap_length(map) == 2000);
+        assert(*(int*) hashmap_get_ref(map, &(int){1999 * 1009}) == 1999);
+        hashmap_free(map);
+        remove(path);
 }
 
 void random_test(void){
@@ -114,6 +138,64 @@ void string_test(void){
         test_ok();
 }
 
+/* String keys, copied by the map */
+void string_keys_test(void){
+        test_step("String keys");
+        hash_map_t *map = hashmap_init_string_keys(sizeof(int));
+        const int n = 20000;
+        char buf[32];
+        for (int i = 0; i < n; i++) {
+                char *str = buf;
+                sprintf(buf, "key-%d", i);
+                assert(hashmap_put(map, &str, &i) == GDS_SUCCESS);
+        }
+        /* The caller's buffer can be reused: the map has its own copies */
+        strcpy(buf, "not a key");
+        assert(hashmap_length(map) == (size_t) n);
+        for (int i = 0; i < n; i++) {
+                char *str = buf;
+                sprintf(buf, "key-%d", i);
+                int v;
+                assert(hashmap_get(map, &str, &v) && v == i);
+                const char *const *key = hashmap_get_key(map, &str);
+                assert(key && *key != buf && strcmp(*key, buf) == 0);
+        }
+        /* Same hash length, different bytes, and prefixes */
+        assert(!hashmap_exists(map, &(char*){"key-"}));
+        assert(!hashmap_exists(map, &(char*){"key-200000"}));
+        assert(!hashmap_exists(map, &(char*){""}));
+
+        for (int i = 0; i < n; i += 2) {
+                char *str = buf;
+                sprintf(buf, "key-%d", i);
+                assert(hashmap_remove(map, &str) == GDS_SUCCESS);
+        }
+        hashmap_iterator_t it = hashmap_iterator(map);
+        char **key;
+        int *value, count = 0;
+        while (hashmap_it_next(&it, (void**) &key, (void**) &value)) {
+                sprintf(buf, "key-%d", *value);
+                assert(*value % 2 == 1 && strcmp(*key, buf) == 0);
+                count++;
+        }
+        assert(count == n / 2);
+
+        hash_map_t *dup = hashmap_dup(map);
+        hashmap_free(map);
+        assert(hashmap_length(dup) == (size_t) n / 2);
+        assert(hashmap_exists(dup, &(char*){"key-1"}));
+        assert(!hashmap_exists(dup, &(char*){"key-0"}));
+        assert(!hashmap_freeze(dup));
+        assert(hashmap_save(dup, "/tmp/gds_string_keys.map") == GDS_INVALID_PARAMETER_ERROR);
+
+        hashmap_clear(dup);
+        assert(!hashmap_exists(dup, &(char*){"key-1"}));
+        assert(hashmap_put(dup, &(char*){"key-1"}, &(int){1}) == GDS_SUCCESS);
+        assert(hashmap_exists(dup, &(char*){"key-1"}));
+        hashmap_free(dup);
+        test_ok();
+}
+
 // Struct test
 
 struct key{
@@ -201,6 +283,586 @@ void hashset_test(void) {
         hashmap_free(set);
 }
 
+void tombstone_test(void) {
+        test_step("Tombstones");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(hashmap_configure(map, LINEAR_HASHING, DICT_NO_SHRINKING, 0.0f));
+
+        /* 0, 5, 10... collide in the initial table, so removing the first
+           one leaves a DELETED slot in the middle of the probe sequence. */
+        for (int i = 0; i < 3; i++)
+                assert(hashmap_put(map, &(int){i * 5}, &i) == GDS_SUCCESS);
+        assert(hashmap_remove(map, &(int){0}) == GDS_SUCCESS);
+        assert(hashmap_put(map, &(int){10}, &(int){42}) == GDS_SUCCESS);
+        assert(hashmap_length(map) == 2);
+        assert(hashmap_remove(map, &(int){10}) == GDS_SUCCESS);
+        assert(!hashmap_exists(map, &(int){10}));
+        assert(*(int*)hashmap_get_ref(map, &(int){5}) == 1);
+
+        hashmap_free(map);
+        test_ok();
+}
+
+static int hash_calls = 0;
+
+static hashcode_t counting_hash(const void *arg) {
+        hash_calls++;
+        return hash_int(arg);
+}
+
+void hash_once_test(void) {
+        test_step("Hash once");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), counting_hash, compare_int);
+        const int n = 1000;
+
+        /* The map grows several times while we insert,
+           but the keys must only be hashed by the put itself. */
+        for (int i = 0; i < n; i++)
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+        assert(hash_calls == n);
+
+        hash_calls = 0;
+        for (int i = 0; i < n; i++)
+                assert(hashmap_get_ref(map, &i));
+        assert(hash_calls == n);
+
+        hashmap_free(map);
+        test_ok();
+}
+
+void swiss_test(void) {
+        test_step("Swiss");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(hashmap_configure(map, SWISS_HASHING, DICT_NO_SHRINKING, 0.0f));
+        const int n = 5000;
+
+        for (int i = 0; i < n; i++)
+                assert(hashmap_put(map, &i, &(int){i * 2}) == GDS_SUCCESS);
+        for (int i = 0; i < n; i += 2)
+                assert(hashmap_remove(map, &i) == GDS_SUCCESS);
+        assert(hashmap_length(map) == (size_t)n / 2);
+
+        for (int i = 0; i < n * 2; i++) {
+                int *v = hashmap_get_ref(map, &i);
+                if (i < n && i % 2 != 0)
+                        assert(v && *v == i * 2);
+                else
+                        assert(!v);
+        }
+
+        /* The elements must be found after changing the probe sequence */
+        assert(hashmap_configure(map, QUADRATIC_HASHING, 0.0f, 0.0f));
+        for (int i = 1; i < n; i += 2)
+                assert(hashmap_exists(map, &i));
+        assert(hashmap_configure(map, SWISS_HASHING, 0.0f, 0.0f));
+        for (int i = 1; i < n; i += 2)
+                assert(hashmap_exists(map, &i));
+
+        hashmap_free(map);
+        test_ok();
+}
+
+/* Random puts and removes, checked against a plain array */
+static void churn_map(hash_map_t *map) {
+        const int n = 512;
+        int ref[512];
+        for (int i = 0; i < n; i++)
+                ref[i] = -1;
+
+        size_t len = 0;
+        for (int it = 0; it < 20000; it++) {
+                int k = rand() % n;
+                if (rand() % 2) {
+                        assert(hashmap_put(map, &k, &it) == GDS_SUCCESS);
+                        if (ref[k] < 0)
+                                len++;
+                        ref[k] = it;
+                } else {
+                        int status = hashmap_remove(map, &k);
+                        if (ref[k] < 0) {
+                                assert(status == GDS_ELEMENT_NOT_FOUND_ERROR);
+                        } else {
+                                assert(status == GDS_SUCCESS);
+                                len--;
+                        }
+                        ref[k] = -1;
+                }
+                assert(hashmap_length(map) == len);
+        }
+        for (int i = 0; i < n; i++) {
+                int *v = hashmap_get_ref(map, &i);
+                if (ref[i] < 0)
+                        assert(!v);
+                else
+                        assert(v && *v == ref[i]);
+        }
+}
+
+static void churn(enum Redispersion redispersion, double min_lf, size_t rehash_step) {
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(hashmap_configure(map, redispersion, min_lf, 0.0f));
+        hashmap_set_incremental_rehash(map, rehash_step);
+        churn_map(map);
+        hashmap_free(map);
+}
+
+void robin_hood_test(void) {
+        test_step("Robin Hood");
+        churn(ROBIN_HOOD_HASHING, DICT_NO_SHRINKING, 0);
+        churn(ROBIN_HOOD_HASHING, DICT_DEF_MIN_LF, 0);
+
+        /* Every other mode must behave the same way */
+        churn(LINEAR_HASHING, DICT_NO_SHRINKING, 0);
+        churn(QUADRATIC_HASHING, DICT_DEF_MIN_LF, 0);
+        churn(SWISS_HASHING, DICT_NO_SHRINKING, 0);
+
+        /* Robin Hood with a full table */
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(hashmap_configure(map, ROBIN_HOOD_HASHING, DICT_NO_SHRINKING, 1.5));
+        for (int i = 0; i < 100; i++)
+                assert(hashmap_put(map, &(int){i * 7}, &i) == GDS_SUCCESS);
+        for (int i = 0; i < 100; i++)
+                assert(*(int*)hashmap_get_ref(map, &(int){i * 7}) == i);
+        hashmap_free(map);
+
+        test_ok();
+}
+
+void incremental_rehash_test(void) {
+        test_step("Incremental rehash");
+        churn(LINEAR_HASHING, DICT_DEF_MIN_LF, 1);
+        churn(QUADRATIC_HASHING, DICT_NO_SHRINKING, 2);
+        churn(SWISS_HASHING, DICT_DEF_MIN_LF, 4);
+        churn(ROBIN_HOOD_HASHING, DICT_DEF_MIN_LF, 1);
+
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        hashmap_set_incremental_rehash(map, 1);
+        bool rehashed = false;
+        for (int i = 0; i < 1000; i++) {
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+                rehashed |= hashmap_is_rehashing(map);
+        }
+        assert(rehashed);
+        /* Finish the pending migration, as if we were idle */
+        while (hashmap_rehash_step(map, 8))
+                ;
+        assert(!hashmap_is_rehashing(map));
+        for (int i = 0; i < 1000; i++)
+                assert(*(int*)hashmap_get_ref(map, &i) == i);
+        hashmap_free(map);
+
+        test_ok();
+}
+
+void pow2_test(void) {
+        test_step("Power of two sizing");
+        for (enum Redispersion r = LINEAR_HASHING; r <= ROBIN_HOOD_HASHING; r++) {
+                hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+                assert(hashmap_set_sizing(map, POW2_SIZING) == GDS_SUCCESS);
+                assert(hashmap_configure(map, r, DICT_DEF_MIN_LF, 0.0f));
+                hashmap_set_incremental_rehash(map, r % 2);
+                churn_map(map);
+                hashmap_free(map);
+        }
+
+        /* Switching on a non empty map keeps the elements */
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        for (int i = 0; i < 1000; i++)
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+        assert(hashmap_set_sizing(map, POW2_SIZING) == GDS_SUCCESS);
+        for (int i = 0; i < 1000; i++)
+                assert(*(int*)hashmap_get_ref(map, &i) == i);
+        for (int i = 1000; i < 2000; i++)
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+        assert(hashmap_set_sizing(map, PRIME_SIZING) == GDS_SUCCESS);
+        for (int i = 0; i < 2000; i++)
+                assert(*(int*)hashmap_get_ref(map, &i) == i);
+        assert(hashmap_length(map) == 2000);
+        hashmap_free(map);
+
+        test_ok();
+}
+
+void dup_test(void) {
+        test_step("Dup");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        hashmap_set_incremental_rehash(map, 1);
+        for (int i = 0; i < 100; i++)
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+        hash_map_t *dup = hashmap_dup(map);
+        assert(dup);
+        for (int i = 0; i < 100; i += 2)
+                assert(hashmap_remove(map, &i) == GDS_SUCCESS);
+        assert(hashmap_length(dup) == 100);
+        for (int i = 0; i < 100; i++)
+                assert(*(int*)hashmap_get_ref(dup, &i) == i);
+        for (int i = 100; i < 200; i++)
+                assert(hashmap_put(dup, &i, &i) == GDS_SUCCESS);
+        assert(hashmap_length(map) == 50);
+        hashmap_free(map, dup);
+        test_ok();
+}
+
+void batch_test(void) {
+        test_step("Batch");
+        enum { N = 1000 };
+        int keys[N], values[N], dests[N];
+        bool found[N];
+        for (int i = 0; i < N; i++) {
+                keys[i] = i * 3;
+                values[i] = i;
+        }
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        /* Only put the even positions */
+        for (int i = 0; i < N; i += 2)
+                assert(hashmap_put(map, &keys[i], &values[i]) == GDS_SUCCESS);
+        assert(hashmap_get_batch(map, keys, N, dests, found) == N / 2);
+        for (int i = 0; i < N; i++) {
+                assert(found[i] == (i % 2 == 0));
+                if (found[i])
+                        assert(dests[i] == i);
+        }
+
+        for (int i = 0; i < N; i++)
+                values[i] = -i;
+        assert(hashmap_put_batch(map, keys, values, N) == GDS_SUCCESS);
+        assert(hashmap_length(map) == N);
+        assert(hashmap_get_batch(map, keys, N, dests, NULL) == N);
+        for (int i = 0; i < N; i++)
+                assert(dests[i] == -i);
+        hashmap_free(map);
+
+        /* Sets don't need values */
+        hash_map_t *set = hashmap_init(sizeof(int), 0, hash_int, compare_int);
+        assert(hashmap_put_batch(set, keys, NULL, 10) == GDS_SUCCESS);
+        assert(hashmap_length(set) == 10);
+        hashmap_free(set);
+        test_ok();
+}
+
+static void sum_values(const void *key, void *value, void *args) {
+        assert(*(const int*) key == *(int*) value);
+        *(long*) args += *(int*) value;
+        *(int*) value = 0;
+}
+
+void iterator_test(void) {
+        test_step("Iterator");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        hashmap_iterator_t it = hashmap_iterator(map);
+        assert(!hashmap_it_next(&it, NULL, NULL));
+
+        /* Incremental rehash, to also walk the old table */
+        hashmap_set_incremental_rehash(map, 1);
+        const int n = 1000;
+        long expected = 0;
+        for (int i = 0; i < n; i++) {
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+                expected += i;
+        }
+        bool *seen = calloc(n, sizeof(bool));
+        it = hashmap_iterator(map);
+        void *key, *value;
+        int count = 0;
+        while (hashmap_it_next(&it, &key, &value)) {
+                int k = *(int*) key;
+                assert(k == *(int*) value);
+                assert(!seen[k]);
+                seen[k] = true;
+                count++;
+        }
+        assert(count == n);
+        assert(!hashmap_it_next(&it, &key, &value));
+        free(seen);
+
+        long sum = 0;
+        hashmap_foreach(map, sum_values, &sum);
+        assert(sum == expected);
+        for (int i = 0; i < n; i++)
+                assert(*(int*) hashmap_get_ref(map, &i) == 0);
+        hashmap_free(map);
+        test_ok();
+}
+
+void entry_test(void) {
+        test_step("Entry");
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), counting_hash, compare_int);
+        hashmap_set_incremental_rehash(map, 2);
+        int counts[100] = {0};
+        for (int it = 0; it < 5000; it++) {
+                int k = rand() % 100;
+                bool inserted;
+                hash_calls = 0;
+                int *count = hashmap_entry(map, &k, &inserted);
+                assert(hash_calls == 1);
+                assert(count);
+                assert(inserted == (counts[k] == 0));
+                if (inserted)
+                        assert(*count == 0);
+                (*count)++;
+                counts[k]++;
+        }
+        for (int k = 0; k < 100; k++) {
+                int *count = hashmap_get_ref(map, &k);
+                if (counts[k] == 0)
+                        assert(!count);
+                else
+                        assert(count && *count == counts[k]);
+        }
+        hashmap_free(map);
+        test_ok();
+}
+
+static bool is_odd(const void *key, void *value, void *args) {
+        (void) value;
+        (*(int*) args)++;
+        return *(const int*) key % 2 == 1;
+}
+
+void retain_test(void) {
+        test_step("Retain");
+        for (enum Redispersion r = LINEAR_HASHING; r <= ROBIN_HOOD_HASHING; r++) {
+                hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+                assert(hashmap_configure(map, r, DICT_DEF_MIN_LF, 0.0f));
+                for (int i = 0; i < 2000; i++)
+                        assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+                /* Keys 1990..1999 are the only even ones left */
+                for (int i = 0; i < 1990; i += 2)
+                        assert(hashmap_remove(map, &i) == GDS_SUCCESS);
+                int calls = 0;
+                assert(hashmap_retain(map, is_odd, &calls) == 5);
+                assert(calls >= 1005);
+                assert(hashmap_length(map) == 1000);
+                for (int i = 0; i < 2000; i++)
+                        assert(hashmap_exists(map, &i) == (i % 2 == 1));
+                hashmap_free(map);
+        }
+        test_ok();
+}
+
+void reserve_test(void) {
+        test_step("Reserve");
+        const int n = 10000;
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+        assert(hashmap_reserve(map, n) == GDS_SUCCESS);
+        /* With incremental rehashing, we can see if the table ever grows */
+        hashmap_set_incremental_rehash(map, 1);
+        for (int i = 0; i < n; i++) {
+                assert(hashmap_put(map, &i, &i) == GDS_SUCCESS);
+                assert(!hashmap_is_rehashing(map));
+        }
+        hashmap_free(map);
+
+        int *keys = malloc(n * sizeof(int)), *values = malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++) {
+                keys[i] = i % (n / 2);
+                values[i] = i;
+        }
+        map = hashmap_from_arrays(keys, values, n, sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+        assert(map);
+        assert(hashmap_length(map) == (size_t) n / 2);
+        /* The last value wins */
+        for (int i = 0; i < n / 2; i++)
+                assert(*(int*) hashmap_get_ref(map, &i) == i + n / 2);
+        hashmap_free(map);
+        free(keys);
+        free(values);
+        test_ok();
+}
+
+void snapshot_test(void) {
+        test_step("Snapshot");
+        const char *path = "hash_map_test.snapshot";
+        const int n = 5000;
+        enum Redispersion modes[] = { LINEAR_HASHING, QUADRATIC_HASHING, SWISS_HASHING, ROBIN_HOOD_HASHING };
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+                for (enum Sizing sizing = PRIME_SIZING; sizing <= POW2_SIZING; sizing++) {
+                        hash_map_t *map = hashmap_init(sizeof(int), sizeof(long), hash_int, compare_int);
+                        hashmap_configure(map, modes[m], DICT_NO_SHRINKING, 0.0f);
+                        hashmap_set_sizing(map, sizing);
+                        for (int i = 0; i < n; i++)
+                                hashmap_put(map, &i, &(long){i * 3L});
+                        /* Leave some tombstones in the image */
+                        for (int i = 0; i < n; i += 4)
+                                hashmap_remove(map, &i);
+                        assert(hashmap_save(map, path) == GDS_SUCCESS);
+                        hashmap_free(map);
+
+                        map = hashmap_open_mmap(path, hash_int, compare_int);
+                        assert(map);
+                        assert(hashmap_is_read_only(map));
+                        assert(hashmap_length(map) == (size_t) n - n / 4);
+                        for (int i = 0; i < n; i++) {
+                                long *v = hashmap_get_ref(map, &i);
+                                if (i % 4 == 0)
+                                        assert(!v);
+                                else
+                                        assert(v && *v == i * 3L);
+                        }
+                        assert(hashmap_put(map, &(int){1}, &(long){0}) == GDS_READ_ONLY_ERROR);
+                        assert(hashmap_remove(map, &(int){1}) == GDS_READ_ONLY_ERROR);
+                        assert(hashmap_entry(map, &(int){-1}, NULL) == NULL);
+                        assert(hashmap_compact(map) == GDS_READ_ONLY_ERROR);
+                        assert(hashmap_set_tombstone_threshold(map, 0.01) == GDS_READ_ONLY_ERROR);
+                        hashmap_clear(map);
+                        assert(hashmap_length(map) == (size_t) n - n / 4);
+
+                        /* A copy can be modified */
+                        hash_map_t *dup = hashmap_dup(map);
+                        assert(!hashmap_is_read_only(dup));
+                        assert(hashmap_put(dup, &(int){1}, &(long){0}) == GDS_SUCCESS);
+                        assert(*(long*) hashmap_get_ref(map, &(int){1}) == 3L);
+                        hashmap_free(map, dup);
+                }
+        }
+
+        /* The stored hashes must match the hash function */
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+        hashcode_t seed = hash_seed();
+        hashmap_put(map, &(int){1}, &(int){1});
+        assert(hashmap_save(map, path) == GDS_SUCCESS);
+        hashmap_free(map);
+        hash_set_seed(seed + 1);
+        assert(!hashmap_open_mmap(path, hash_u32_mix, compare_int));
+        hash_set_seed(seed);
+        map = hashmap_open_mmap(path, hash_u32_mix, compare_int);
+        assert(map && *(int*) hashmap_get_ref(map, &(int){1}) == 1);
+        hashmap_free(map);
+
+        /* Not an image */
+        FILE *f = fopen(path, "wb");
+        fputs("key,value\n1,2\n", f);
+        fclose(f);
+        assert(!hashmap_open_mmap(path, hash_int, compare_int));
+        remove(path);
+        assert(!hashmap_open_mmap(path, hash_int, compare_int));
+        test_ok();
+}
+
+static hashcode_t constant_hash(const void *arg){
+        (void) arg;
+        return 42;
+}
+
+void stats_test(void) {
+        test_step("Stats");
+        const int n = 10000;
+        enum Redispersion modes[] = { LINEAR_HASHING, QUADRATIC_HASHING, SWISS_HASHING, ROBIN_HOOD_HASHING };
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+                hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+                hashmap_configure(map, modes[m], DICT_NO_SHRINKING, 0.0f);
+                for (int i = 0; i < n; i++)
+                        hashmap_put(map, &i, &i);
+                for (int i = 0; i < n; i += 2)
+                        hashmap_remove(map, &i);
+
+                hashmap_stats_t st;
+                assert(hashmap_stats(map, &st) == GDS_SUCCESS);
+                assert(st.n_full == hashmap_length(map));
+                assert(st.n_full + st.n_deleted + st.n_empty == st.capacity);
+                if (modes[m] == ROBIN_HOOD_HASHING)
+                        assert(st.n_deleted == 0);
+                else
+                        assert(st.n_deleted > 0);
+                assert(st.n_redispersions > 0);
+                assert(st.avg_probe >= 1.0 && st.avg_probe < 4.0);
+                assert(st.p99_probe >= 1 && st.p99_probe <= st.max_probe);
+                assert(st.bytes > st.capacity * 2 * sizeof(int));
+                size_t total = 0;
+                for (int i = 0; i < HASHMAP_PROBE_HISTOGRAM; i++)
+                        total += st.probe_histogram[i];
+                assert(total == st.n_full);
+                hashmap_free(map);
+        }
+
+        /* With a constant hash, the i-th key needs i probes */
+        const int bad = 500;
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), constant_hash, compare_int);
+        for (int i = 0; i < bad; i++)
+                hashmap_put(map, &i, &i);
+        hashmap_stats_t st;
+        assert(hashmap_stats(map, &st) == GDS_SUCCESS);
+        assert(st.max_probe == (size_t) bad);
+        assert(st.p99_probe == (size_t) (bad - bad / 100));
+        assert(st.avg_probe == (bad + 1) / 2.0);
+        assert(st.probe_histogram[HASHMAP_PROBE_HISTOGRAM - 1] == (size_t) (bad - HASHMAP_PROBE_HISTOGRAM + 1));
+        hashmap_free(map);
+        test_ok();
+}
+
+static void* failing_malloc(size_t n){ (void) n; return NULL; }
+static void* failing_calloc(size_t n, size_t size){ (void) n; (void) size; return NULL; }
+static void* failing_realloc(void *ptr, size_t n){ (void) ptr; (void) n; return NULL; }
+
+static bool keep_multiple_of_3(const void *key, void *value, void *args){
+        (void) value; (void) args;
+        return * (int*) key % 3 == 0;
+}
+
+void compact_test(void) {
+        test_step("Compact");
+        const int n = 6000;
+        enum Redispersion modes[] = { LINEAR_HASHING, QUADRATIC_HASHING, SWISS_HASHING, ROBIN_HOOD_HASHING };
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+                for (enum Sizing sizing = PRIME_SIZING; sizing <= POW2_SIZING; sizing++) {
+                        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+                        hashmap_configure(map, modes[m], DICT_NO_SHRINKING, 0.0f);
+                        hashmap_set_sizing(map, sizing);
+                        assert(hashmap_set_tombstone_threshold(map, DICT_NO_COMPACTION) == GDS_SUCCESS);
+                        for (int i = 0; i < n; i++)
+                                hashmap_put(map, &i, &i);
+                        for (int i = 0; i < n; i++) {
+                                if (i % 3 != 0)
+                                        hashmap_remove(map, &i);
+                        }
+                        hashmap_stats_t before, after;
+                        hashmap_stats(map, &before);
+                        if (modes[m] != ROBIN_HOOD_HASHING)
+                                assert(before.n_deleted == (size_t) (n - n / 3));
+
+                        assert(hashmap_compact(map) == GDS_SUCCESS);
+                        hashmap_stats(map, &after);
+                        assert(after.n_deleted == 0);
+                        assert(after.capacity == before.capacity);
+                        assert(after.n_redispersions == before.n_redispersions);
+                        assert(after.avg_probe <= before.avg_probe);
+                        for (int i = 0; i < n; i++) {
+                                int *v = hashmap_get_ref(map, &i);
+                                if (i % 3 == 0)
+                                        assert(v && *v == i);
+                                else
+                                        assert(!v);
+                        }
+
+                        /* With a threshold, the map compacts itself */
+                        hashmap_clear(map);
+                        assert(hashmap_set_tombstone_threshold(map, 0.05) == GDS_SUCCESS);
+                        churn_map(map);
+                        hashmap_stats(map, &after);
+                        assert(after.n_deleted <= after.capacity / 20);
+                        hashmap_free(map);
+                }
+        }
+
+        /* If hashmap_retain can't shrink, it still compacts */
+        hash_map_t *map = hashmap_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int);
+        hashmap_configure(map, SWISS_HASHING, 0.2f, 0.0f);
+        for (int i = 0; i < n; i++)
+                hashmap_put(map, &i, &i);
+        hashmap_stats_t before, after;
+        hashmap_stats(map, &before);
+        gds_set_allocator(failing_malloc, failing_calloc, failing_realloc, free);
+        assert(hashmap_retain(map, keep_multiple_of_3, NULL) == (size_t) (n - (n + 2) / 3));
+        gds_set_allocator(malloc, calloc, realloc, free);
+        hashmap_stats(map, &after);
+        assert(after.capacity == before.capacity);
+        assert(after.n_deleted == 0);
+        for (int i = 0; i < n; i++)
+                assert(hashmap_exists(map, &i) == (i % 3 == 0));
+        hashmap_free(map);
+        test_ok();
+}
+
 int main(void){
 	test_start("hash_map.c");
 
@@ -210,9 +872,25 @@ int main(void){
         config();
         random_test();
         string_test();
+        string_keys_test();
         struct_test();
 	destructor_test();
         hashset_test();
+        tombstone_test();
+        hash_once_test();
+        swiss_test();
+        robin_hood_test();
+        incremental_rehash_test();
+        pow2_test();
+        dup_test();
+        batch_test();
+        iterator_test();
+        entry_test();
+        retain_test();
+        reserve_test();
+        snapshot_test();
+        stats_test();
+        compact_test();
 
 	test_end("hash_map.c");
         return 0;
@@ -0,0 +1,134 @@
+#include "../include/hash_multimap.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        hash_multimap_t *map = multimap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(map);
+        for (int i = 0; i < 100; i++)
+                assert(multimap_put(map, &(int){i % 3}, &i) == GDS_SUCCESS);
+        assert(multimap_length(map) == 100);
+        assert(multimap_n_keys(map) == 3);
+        assert(multimap_count(map, &(int){0}) == 34);
+        assert(multimap_count(map, &(int){2}) == 33);
+        assert(multimap_count(map, &(int){3}) == 0);
+
+        /* The values come out in insertion order */
+        multimap_range_t range = multimap_equal_range(map, &(int){1});
+        int *v, expected = 1;
+        while ((v = multimap_range_next(&range))) {
+                assert(*v == expected);
+                expected += 3;
+        }
+        assert(expected == 100);
+        range = multimap_equal_range(map, &(int){5});
+        assert(!multimap_range_next(&range));
+
+        assert(multimap_remove(map, &(int){0}) == GDS_SUCCESS);
+        assert(multimap_remove(map, &(int){0}) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        assert(!multimap_exists(map, &(int){0}));
+        assert(multimap_length(map) == 66);
+        multimap_free(map);
+}
+
+static int n_destroyed;
+
+static void count_destroyed(void *arg){
+        (void) arg;
+        n_destroyed++;
+}
+
+void bulk_test(void){
+        test_step("Bulk insert");
+        const int n = 100000;
+        int *keys = malloc(n * sizeof(int));
+        long *values = malloc(n * sizeof(long));
+        for (int i = 0; i < n; i++) {
+                keys[i] = i / 100;
+                values[i] = i;
+        }
+        hash_multimap_t *map = multimap_init(sizeof(int), sizeof(long), hash_u32_mix, compare_int);
+        multimap_set_destructor(map, count_destroyed);
+        assert(multimap_put_batch(map, keys, values, n) == GDS_SUCCESS);
+        assert(multimap_put_values(map, &(int){0}, values, 10) == GDS_SUCCESS);
+        assert(multimap_length(map) == (size_t) n + 10);
+        assert(multimap_n_keys(map) == (size_t) n / 100);
+
+        for (int k = 0; k < n / 100; k++) {
+                multimap_range_t range = multimap_equal_range(map, &k);
+                size_t len, total = 0;
+                long *run;
+                while ((run = multimap_range_next_run(&range, &len))) {
+                        for (size_t j = 0; j < len; j++, total++)
+                                assert(run[j] == (total < 100 ? k * 100 + (long) total : (long) total - 100));
+                }
+                assert(total == multimap_count(map, &k));
+        }
+
+        multimap_clear(map);
+        assert(n_destroyed == n + 10);
+        assert(multimap_length(map) == 0 && multimap_n_keys(map) == 0);
+        multimap_free(map);
+        free(keys);
+        free(values);
+        test_ok();
+}
+
+/* Random puts and removes, checked against a count per key-value pair */
+void random_test(void){
+        test_step("Random");
+        enum { N_KEYS = 50, N_VALUES = 20 };
+        int counts[N_KEYS][N_VALUES] = {0};
+        size_t total = 0;
+        hash_multimap_t *map = multimap_init(sizeof(int), sizeof(short), hash_u32_mix, compare_int);
+        for (int it = 0; it < 200000; it++) {
+                int k = rand() % N_KEYS;
+                short v = rand() % N_VALUES;
+                int r = rand() % 10;
+                if (r < 6) {
+                        assert(multimap_put(map, &k, &v) == GDS_SUCCESS);
+                        counts[k][v]++;
+                        total++;
+                } else if (r < 9) {
+                        int status = multimap_remove_value(map, &k, &v);
+                        assert((status == GDS_SUCCESS) == (counts[k][v] > 0));
+                        if (status == GDS_SUCCESS) {
+                                counts[k][v]--;
+                                total--;
+                        }
+                } else if (rand() % 20 == 0) {
+                        size_t n = 0;
+                        for (int j = 0; j < N_VALUES; j++) {
+                                n += counts[k][j];
+                                counts[k][j] = 0;
+                        }
+                        assert(multimap_remove(map, &k) == (n ? GDS_SUCCESS : GDS_ELEMENT_NOT_FOUND_ERROR));
+                        total -= n;
+                }
+        }
+        assert(multimap_length(map) == total);
+        for (int k = 0; k < N_KEYS; k++) {
+                int found[N_VALUES] = {0};
+                multimap_range_t range = multimap_equal_range(map, &k);
+                short *v;
+                while ((v = multimap_range_next(&range)))
+                        found[*v]++;
+                assert(memcmp(found, counts[k], sizeof(found)) == 0);
+        }
+        multimap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("hash_multimap.c");
+
+        test_simple();
+        bulk_test();
+        random_test();
+
+        test_end("hash_multimap.c");
+        return 0;
+}
@@ -0,0 +1,83 @@
+#include "../include/hash_set.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_simple(void){
+        hashset_t *set = hashset_init(sizeof(int), hash_int, compare_int);
+        assert(set);
+        assert(hashset_add(set, &(int){1}) == GDS_SUCCESS);
+        assert(hashset_add(set, &(int){1}) == GDS_REPEATED_ELEMENT_ERROR);
+        assert(hashset_contains(set, &(int){1}));
+        assert(!hashset_contains(set, &(int){2}));
+        assert(hashset_length(set) == 1);
+        assert(hashset_remove(set, &(int){1}) == GDS_SUCCESS);
+        assert(hashset_remove(set, &(int){1}) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        assert(hashset_length(set) == 0);
+        hashset_free(set);
+}
+
+void brute(void){
+        test_step("Brute");
+        hashset_t *set = hashset_with_capacity(sizeof(int), hash_int, compare_int, 100);
+        for (int i = 0; i < 10000; i++)
+                assert(hashset_add(set, &i) == GDS_SUCCESS);
+        for (int i = 0; i < 10000; i += 2)
+                assert(hashset_remove(set, &i) == GDS_SUCCESS);
+        for (int i = 0; i < 10000; i++)
+                assert(hashset_contains(set, &i) == (i % 2 == 1));
+        vector_t *keys = hashset_keys(set);
+        assert(vector_size(keys) == 5000);
+        vector_free(keys);
+        hashset_clear(set);
+        assert(hashset_length(set) == 0);
+        hashset_free(set);
+        test_ok();
+}
+
+void bulk_test(void){
+        test_step("Union/Intersection/Difference");
+        hashset_t *mult2 = hashset_init(sizeof(int), hash_int, compare_int);
+        hashset_t *mult3 = hashset_init(sizeof(int), hash_int, compare_int);
+        const int n = 3000;
+        for (int i = 0; i < n; i++) {
+                if (i % 2 == 0)
+                        hashset_add(mult2, &i);
+                if (i % 3 == 0)
+                        hashset_add(mult3, &i);
+        }
+
+        hashset_t *u = hashset_union(mult2, mult3);
+        hashset_t *in = hashset_intersection(mult2, mult3);
+        hashset_t *d = hashset_difference(mult2, mult3);
+        int n_u = 0, n_in = 0, n_d = 0;
+        for (int i = 0; i < n; i++) {
+                bool m2 = i % 2 == 0, m3 = i % 3 == 0;
+                assert(hashset_contains(u, &i) == (m2 || m3));
+                assert(hashset_contains(in, &i) == (m2 && m3));
+                assert(hashset_contains(d, &i) == (m2 && !m3));
+                n_u += m2 || m3;
+                n_in += m2 && m3;
+                n_d += m2 && !m3;
+        }
+        assert(hashset_length(u) == (size_t) n_u);
+        assert(hashset_length(in) == (size_t) n_in);
+        assert(hashset_length(d) == (size_t) n_d);
+        /* The operands are left untouched */
+        assert(hashset_length(mult2) == (size_t) n / 2);
+
+        hashset_free(mult2, mult3, u, in, d);
+        test_ok();
+}
+
+int main(void){
+        test_start("hash_set.c");
+
+        test_simple();
+        brute();
+        bulk_test();
+
+        test_end("hash_set.c");
+        return 0;
+}
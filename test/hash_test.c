@@ -0,0 +1,90 @@
+#include "../include/hash.h"
+#include "../include/hash_map.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void bytes_test(void){
+        test_step("hash_bytes");
+        /* Test vectors of wyhash final 4 */
+        const char *msgs[] = {
+                "", "a", "abc", "message digest", "abcdefghijklmnopqrstuvwxyz",
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+                "12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+        };
+        const hashcode_t expected[] = {
+                0x0409638EE2BDE459ULL, 0xA8412D091B5FE0A9ULL, 0x32DD92E4B2915153ULL,
+                0x8619124089A3A16BULL, 0x7A43AFB61D7F5F40ULL, 0xFF42329B90E50D58ULL,
+                0xC39CAB13B115AAD3ULL,
+        };
+        for (int i = 0; i < 7; i++)
+                assert(hash_bytes(msgs[i], strlen(msgs[i]), i) == expected[i]);
+        test_ok();
+}
+
+void seed_test(void){
+        test_step("Seed");
+        hashcode_t seed = hash_seed();
+        assert(seed != 0);
+        assert(hash_seed() == seed);
+
+        char *str = "hello world";
+        int n = 12;
+        hashcode_t h1 = hash_string_fast(&str), h2 = hash_u32_mix(&n);
+        hash_set_seed(seed + 1);
+        assert(hash_string_fast(&str) != h1);
+        assert(hash_u32_mix(&n) != h2);
+        hash_set_seed(seed);
+        assert(hash_string_fast(&str) == h1);
+        assert(hash_u32_mix(&n) == h2);
+        test_ok();
+}
+
+struct point { int x, y; };
+GDS_DEFINE_POD_HASH(hash_point, struct point)
+
+static int compare_point(const void *a, const void *b){
+        return memcmp(a, b, sizeof(struct point));
+}
+
+void pod_test(void){
+        test_step("POD keys");
+        hash_map_t *map = hashmap_init(sizeof(struct point), sizeof(int), hash_point, compare_point);
+        for (int i = 0; i < 100; i++) {
+                for (int j = 0; j < 100; j++)
+                        assert(hashmap_put(map, &(struct point){i, j}, &(int){i * j}) == GDS_SUCCESS);
+        }
+        for (int i = 0; i < 100; i++) {
+                for (int j = 0; j < 100; j++)
+                        assert(*(int*) hashmap_get_ref(map, &(struct point){i, j}) == i * j);
+        }
+        hashmap_free(map);
+        test_ok();
+}
+
+void mix_test(void){
+        test_step("Integer mix");
+        /* Consecutive keys must spread over the high bits too */
+        int buckets[16] = {0};
+        for (uint32_t i = 0; i < 16000; i++)
+                buckets[hash_u32_mix(&i) >> 60]++;
+        for (int i = 0; i < 16; i++)
+                assert(buckets[i] > 800 && buckets[i] < 1200);
+
+        uint64_t a = 1, b = 2;
+        assert(hash_u64_mix(&a) != hash_u64_mix(&b));
+        test_ok();
+}
+
+int main(void){
+        test_start("hash.c");
+
+        bytes_test();
+        seed_test();
+        pod_test();
+        mix_test();
+
+        test_end("hash.c");
+        return 0;
+}
@@ -0,0 +1,53 @@
+#include "../include/interner.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        interner_t *interner = interner_init();
+        assert(interner);
+        assert(interner_intern(interner, "foo") == 0);
+        assert(interner_intern(interner, "bar") == 1);
+        assert(interner_intern(interner, "foo") == 0);
+        assert(interner_intern(interner, "") == 2);
+        assert(interner_length(interner) == 3);
+        assert(interner_find(interner, "bar") == 1);
+        assert(interner_find(interner, "baz") == INTERNER_NOT_FOUND);
+        assert(strcmp(interner_string(interner, 0), "foo") == 0);
+        assert(strcmp(interner_string(interner, 2), "") == 0);
+        assert(!interner_string(interner, 3));
+        interner_free(interner);
+}
+
+void many_test(void){
+        test_step("Many strings");
+        const int n = 100000;
+        interner_t *interner = interner_init();
+        char buf[32];
+        for (int round = 0; round < 2; round++) {
+                for (int i = 0; i < n; i++) {
+                        sprintf(buf, "string number %d", i);
+                        assert(interner_intern(interner, buf) == (size_t) i);
+                }
+        }
+        assert(interner_length(interner) == (size_t) n);
+        for (int i = 0; i < n; i++) {
+                sprintf(buf, "string number %d", i);
+                const char *str = interner_string(interner, i);
+                assert(str != buf && strcmp(str, buf) == 0);
+                assert(interner_find(interner, str) == (size_t) i);
+        }
+        interner_free(interner);
+        test_ok();
+}
+
+int main(void){
+        test_start("interner.c");
+
+        test_simple();
+        many_test();
+
+        test_end("interner.c");
+        return 0;
+}
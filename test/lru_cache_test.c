@@ -0,0 +1,153 @@
+#include "../include/lru_cache.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        lru_cache_t *cache = lru_cache_init(sizeof(int), sizeof(int), hash_int, compare_int, 2);
+        assert(cache);
+        assert(lru_cache_put(cache, &(int){1}, &(int){10}) == GDS_SUCCESS);
+        assert(lru_cache_put(cache, &(int){2}, &(int){20}) == GDS_SUCCESS);
+        int dest;
+        /* 1 is now the most recently used, so 2 is evicted */
+        assert(lru_cache_get(cache, &(int){1}, &dest) && dest == 10);
+        assert(lru_cache_put(cache, &(int){3}, &(int){30}) == GDS_SUCCESS);
+        assert(!lru_cache_exists(cache, &(int){2}));
+        assert(lru_cache_exists(cache, &(int){1}));
+        assert(lru_cache_exists(cache, &(int){3}));
+        assert(lru_cache_length(cache) == 2);
+        assert(!lru_cache_get(cache, &(int){2}, &dest));
+
+        lru_cache_stats_t stats = lru_cache_stats(cache);
+        assert(stats.hits == 1 && stats.misses == 1 && stats.evictions == 1);
+
+        assert(lru_cache_remove(cache, &(int){1}) == GDS_SUCCESS);
+        assert(lru_cache_remove(cache, &(int){1}) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        assert(lru_cache_length(cache) == 1);
+        lru_cache_free(cache);
+}
+
+/* Reference LRU: an array ordered from the most to the least recently used */
+struct ref_lru {
+        int keys[64];
+        int values[64];
+        int len;
+};
+
+static int ref_find(struct ref_lru *r, int key){
+        for (int i = 0; i < r->len; i++) {
+                if (r->keys[i] == key)
+                        return i;
+        }
+        return -1;
+}
+
+static void ref_to_front(struct ref_lru *r, int i){
+        int k = r->keys[i], v = r->values[i];
+        memmove(&r->keys[1], &r->keys[0], i * sizeof(int));
+        memmove(&r->values[1], &r->values[0], i * sizeof(int));
+        r->keys[0] = k;
+        r->values[0] = v;
+}
+
+void random_test(void){
+        test_step("Random");
+        const int capacity = 64;
+        struct ref_lru ref = {0};
+        lru_cache_t *cache = lru_cache_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int, capacity);
+        for (int it = 0; it < 100000; it++) {
+                int k = rand() % 200;
+                int i = ref_find(&ref, k);
+                switch (rand() % 4) {
+                case 0:
+                case 1:
+                        assert(lru_cache_put(cache, &k, &it) == GDS_SUCCESS);
+                        if (i < 0) {
+                                if (ref.len < capacity)
+                                        ref.len++;
+                                i = ref.len - 1;
+                                ref.keys[i] = k;
+                        }
+                        ref.values[i] = it;
+                        ref_to_front(&ref, i);
+                        break;
+                case 2: {
+                        int *v = lru_cache_get_ref(cache, &k);
+                        if (i < 0) {
+                                assert(!v);
+                        } else {
+                                assert(v && *v == ref.values[i]);
+                                ref_to_front(&ref, i);
+                        }
+                        break;
+                }
+                case 3:
+                        assert(lru_cache_remove(cache, &k) == (i < 0 ? GDS_ELEMENT_NOT_FOUND_ERROR : GDS_SUCCESS));
+                        if (i >= 0) {
+                                ref.len--;
+                                memmove(&ref.keys[i], &ref.keys[i + 1], (ref.len - i) * sizeof(int));
+                                memmove(&ref.values[i], &ref.values[i + 1], (ref.len - i) * sizeof(int));
+                        }
+                        break;
+                }
+                assert(lru_cache_length(cache) == (size_t) ref.len);
+        }
+        for (int i = 0; i < ref.len; i++)
+                assert(lru_cache_exists(cache, &ref.keys[i]));
+
+        lru_cache_clear(cache);
+        assert(lru_cache_length(cache) == 0);
+        assert(!lru_cache_exists(cache, &ref.keys[0]));
+        for (int i = 0; i < capacity * 2; i++)
+                assert(lru_cache_put(cache, &i, &i) == GDS_SUCCESS);
+        assert(lru_cache_length(cache) == (size_t) capacity);
+        for (int i = 0; i < capacity * 2; i++)
+                assert(lru_cache_exists(cache, &i) == (i >= capacity));
+        lru_cache_free(cache);
+        test_ok();
+}
+
+static int n_destroyed;
+
+static void free_str(void *arg){
+        free(*(char**) arg);
+        n_destroyed++;
+}
+
+void destructor_test(void){
+        test_step("Destructor");
+        const int capacity = 10;
+        lru_cache_t *cache = lru_cache_init(sizeof(int), sizeof(char*), hash_int, compare_int, capacity);
+        lru_cache_set_destructor(cache, free_str);
+        for (int i = 0; i < 25; i++) {
+                char *str = malloc(8);
+                strcpy(str, "value");
+                assert(lru_cache_put(cache, &i, &str) == GDS_SUCCESS);
+        }
+        /* Evicted */
+        assert(n_destroyed == 15);
+        assert(lru_cache_stats(cache).evictions == 15);
+        /* Replaced */
+        char *str = malloc(8);
+        assert(lru_cache_put(cache, &(int){24}, &str) == GDS_SUCCESS);
+        assert(n_destroyed == 16);
+        /* Removed */
+        assert(lru_cache_remove(cache, &(int){23}) == GDS_SUCCESS);
+        assert(n_destroyed == 17);
+        lru_cache_free(cache);
+        assert(n_destroyed == 17 + capacity - 1);
+        test_ok();
+}
+
+int main(void){
+        test_start("lru_cache.c");
+
+        test_simple();
+        random_test();
+        destructor_test();
+
+        test_end("lru_cache.c");
+        return 0;
+}
@@ -0,0 +1,102 @@
+#include "../include/rcu_hash_map.h"
+#include "hash.h"
+#include "test.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_READERS 4
+#define N_KEYS 256
+
+static rcu_hashmap_t *map;
+static atomic_bool stop;
+
+void test_simple(void){
+        map = rcu_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        assert(map);
+        rcu_reader_t *reader = rcu_hashmap_register_reader(map);
+        int key = 1, value = 2, dest;
+        assert(rcu_hashmap_put(map, &key, &value) == GDS_SUCCESS);
+        assert(rcu_hashmap_exists(map, &key));
+        assert(*(const int*) rcu_hashmap_get_ref(map, &key) == 2);
+        assert(rcu_hashmap_get(map, &key, &dest) && dest == 2);
+        assert(rcu_hashmap_length(map) == 1);
+        rcu_hashmap_quiescent(map, reader);
+        assert(rcu_hashmap_remove(map, &key) == GDS_SUCCESS);
+        assert(!rcu_hashmap_exists(map, &key));
+        assert(rcu_hashmap_remove(map, &key) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        rcu_hashmap_unregister_reader(map, reader);
+        rcu_hashmap_free(map);
+}
+
+static void* reader_thread(void *arg){
+        (void) arg;
+        rcu_reader_t *reader = rcu_hashmap_register_reader(map);
+        while (!atomic_load(&stop)) {
+                for (int k = 0; k < N_KEYS; k++) {
+                        const int *v = rcu_hashmap_get_ref(map, &k);
+                        if (v)
+                                assert(*v == k * 3);
+                }
+                rcu_hashmap_quiescent(map, reader);
+        }
+        rcu_hashmap_unregister_reader(map, reader);
+        return NULL;
+}
+
+static int fill(hash_map_t *draft, void *ctx){
+        int n = *(int*) ctx;
+        for (int k = 0; k < n; k++) {
+                int status = hashmap_put(draft, &k, &(int){k * 3});
+                if (status != GDS_SUCCESS)
+                        return status;
+        }
+        return GDS_SUCCESS;
+}
+
+static int fail(hash_map_t *draft, void *ctx){
+        (void) ctx;
+        hashmap_clear(draft);
+        return GDS_ERROR;
+}
+
+void concurrent_test(void){
+        test_step("Concurrent readers");
+        map = rcu_hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        atomic_store(&stop, false);
+        pthread_t threads[N_READERS];
+        for (int i = 0; i < N_READERS; i++)
+                pthread_create(&threads[i], NULL, reader_thread, NULL);
+
+        for (int it = 0; it < 2000; it++) {
+                int k = rand() % N_KEYS;
+                if (rand() % 2)
+                        assert(rcu_hashmap_put(map, &k, &(int){k * 3}) == GDS_SUCCESS);
+                else
+                        rcu_hashmap_remove(map, &k);
+        }
+        int n = N_KEYS;
+        assert(rcu_hashmap_update(map, fill, &n) == GDS_SUCCESS);
+        assert(rcu_hashmap_length(map) == N_KEYS);
+        /* A failed update publishes nothing */
+        assert(rcu_hashmap_update(map, fail, NULL) == GDS_ERROR);
+        assert(rcu_hashmap_length(map) == N_KEYS);
+
+        rcu_hashmap_synchronize(map);
+        atomic_store(&stop, true);
+        for (int i = 0; i < N_READERS; i++)
+                pthread_join(threads[i], NULL);
+        rcu_hashmap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("rcu_hash_map.c");
+
+        test_simple();
+        concurrent_test();
+
+        test_end("rcu_hash_map.c");
+        return 0;
+}
@@ -0,0 +1,120 @@
+#include "../include/tinylfu_cache.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_simple(void){
+        tinylfu_cache_t *cache = tinylfu_cache_init(sizeof(int), sizeof(int), hash_int, compare_int, 10);
+        assert(cache);
+        for (int i = 0; i < 10; i++)
+                assert(tinylfu_cache_put(cache, &i, &(int){i * 10}) == GDS_SUCCESS);
+        assert(tinylfu_cache_length(cache) == 10);
+        int dest;
+        for (int i = 0; i < 10; i++)
+                assert(tinylfu_cache_get(cache, &i, &dest) && dest == i * 10);
+        assert(!tinylfu_cache_get(cache, &(int){10}, &dest));
+        tinylfu_cache_stats_t stats = tinylfu_cache_stats(cache);
+        assert(stats.hits == 10 && stats.misses == 1 && stats.evictions == 0);
+
+        /* Full. A key that was only seen once is not admitted */
+        assert(tinylfu_cache_put(cache, &(int){10}, &(int){100}) == GDS_SUCCESS);
+        assert(tinylfu_cache_length(cache) == 10);
+        assert(tinylfu_cache_stats(cache).evictions == 1);
+
+        assert(tinylfu_cache_remove(cache, &(int){5}) == GDS_SUCCESS);
+        assert(tinylfu_cache_remove(cache, &(int){5}) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        assert(!tinylfu_cache_exists(cache, &(int){5}));
+        assert(tinylfu_cache_length(cache) == 9);
+        tinylfu_cache_free(cache);
+}
+
+/*
+ * A hot set, accessed many times, must survive
+ * a scan of keys that are only used once.
+ */
+void scan_test(void){
+        test_step("Scan resistance");
+        const int capacity = 1000, hot = 500;
+        tinylfu_cache_t *cache = tinylfu_cache_init(sizeof(int), sizeof(int), hash_int, compare_int, capacity);
+        for (int round = 0; round < 5; round++) {
+                for (int i = 0; i < hot; i++) {
+                        if (!tinylfu_cache_get_ref(cache, &i))
+                                assert(tinylfu_cache_put(cache, &i, &i) == GDS_SUCCESS);
+                }
+        }
+        for (int i = hot; i < hot + 100 * capacity; i++) {
+                if (!tinylfu_cache_get_ref(cache, &i))
+                        assert(tinylfu_cache_put(cache, &i, &i) == GDS_SUCCESS);
+                assert(tinylfu_cache_length(cache) <= (size_t) capacity);
+        }
+        int survivors = 0;
+        for (int i = 0; i < hot; i++)
+                survivors += tinylfu_cache_exists(cache, &i);
+        assert(survivors >= hot * 9 / 10);
+        tinylfu_cache_free(cache);
+        test_ok();
+}
+
+static int n_destroyed;
+
+static void count_destroyed(void *arg){
+        (void) arg;
+        n_destroyed++;
+}
+
+/* Random operations, checking that the values are right and no entry is lost */
+void random_test(void){
+        test_step("Random");
+        const int capacity = 100, n_keys = 400;
+        int *values = malloc(n_keys * sizeof(int));
+        tinylfu_cache_t *cache = tinylfu_cache_init(sizeof(int), sizeof(int), hash_u32_mix, compare_int, capacity);
+        tinylfu_cache_set_destructor(cache, count_destroyed);
+        int inserted = 0;
+        for (int it = 0; it < 200000; it++) {
+                /* Skewed keys, so some of them are more frequent */
+                int k = rand() % (rand() % n_keys + 1);
+                int r = rand() % 10;
+                if (r < 3) {
+                        if (!tinylfu_cache_exists(cache, &k))
+                                inserted++;
+                        else
+                                n_destroyed--;  // Not an eviction
+                        assert(tinylfu_cache_put(cache, &k, &it) == GDS_SUCCESS);
+                        values[k] = it;
+                } else if (r < 9) {
+                        int *v = tinylfu_cache_get_ref(cache, &k);
+                        assert(!v || *v == values[k]);
+                } else if (tinylfu_cache_remove(cache, &k) == GDS_SUCCESS) {
+                        n_destroyed--;
+                        inserted--;
+                }
+                assert(tinylfu_cache_length(cache) <= (size_t) capacity);
+                assert((int) tinylfu_cache_length(cache) == inserted - n_destroyed);
+        }
+        size_t len = 0;
+        for (int i = 0; i < n_keys; i++)
+                len += tinylfu_cache_exists(cache, &i);
+        assert(len == tinylfu_cache_length(cache));
+
+        tinylfu_cache_clear(cache);
+        assert(tinylfu_cache_length(cache) == 0);
+        for (int i = 0; i < capacity; i++)
+                assert(tinylfu_cache_put(cache, &i, &i) == GDS_SUCCESS);
+        assert(tinylfu_cache_length(cache) == (size_t) capacity);
+        tinylfu_cache_free(cache);
+        free(values);
+        test_ok();
+}
+
+int main(void){
+        test_start("tinylfu_cache.c");
+
+        test_simple();
+        scan_test();
+        random_test();
+
+        test_end("tinylfu_cache.c");
+        return 0;
+}
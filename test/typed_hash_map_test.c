@@ -0,0 +1,104 @@
+#include "../include/typed_hash_map.h"
+#include "../include/hash_map.h"
+#include "hash.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GDS_DEFINE_HASHMAP(intmap, int, int, gds_mix64(key), a == b)
+
+struct point { int x, y; };
+
+/* A weak hash, so there are lots of collisions */
+GDS_DEFINE_HASHMAP(pointmap, struct point, double, key.x % 7, a.x == b.x && a.y == b.y)
+
+void test_simple(void){
+        intmap_t *map = intmap_init();
+        assert(map);
+        for (int i = 0; i < 100; i++)
+                assert(intmap_put(map, i, i * 2) == GDS_SUCCESS);
+        assert(intmap_length(map) == 100);
+        int v;
+        for (int i = 0; i < 100; i++)
+                assert(intmap_get(map, i, &v) && v == i * 2);
+        assert(!intmap_get_ref(map, 100));
+        assert(intmap_put(map, 5, 0) == GDS_SUCCESS);
+        assert(*intmap_get_ref(map, 5) == 0 && intmap_length(map) == 100);
+        assert(intmap_remove(map, 5) == GDS_SUCCESS);
+        assert(intmap_remove(map, 5) == GDS_ELEMENT_NOT_FOUND_ERROR);
+        assert(!intmap_exists(map, 5));
+
+        bool inserted;
+        int *count = intmap_entry(map, 1000, &inserted);
+        assert(inserted && *count == 0);
+        (*count)++;
+        assert(*intmap_entry(map, 1000, &inserted) == 1 && !inserted);
+
+        intmap_clear(map);
+        assert(intmap_length(map) == 0 && !intmap_exists(map, 1));
+        intmap_free(map);
+}
+
+/* Random operations, checked against a hash_map_t */
+void random_test(void){
+        test_step("Random");
+        intmap_t *map = intmap_init();
+        hash_map_t *ref = hashmap_init(sizeof(int), sizeof(int), hash_int, compare_int);
+        for (int it = 0; it < 500000; it++) {
+                int k = rand() % 5000;
+                int r = rand() % 10;
+                if (r < 5) {
+                        assert(intmap_put(map, k, it) == GDS_SUCCESS);
+                        hashmap_put(ref, &k, &it);
+                } else if (r < 8) {
+                        assert(intmap_remove(map, k) == hashmap_remove(ref, &k));
+                } else {
+                        int *v = intmap_get_ref(map, k);
+                        int *w = hashmap_get_ref(ref, &k);
+                        assert((v == NULL) == (w == NULL));
+                        assert(!v || *v == *w);
+                }
+                assert(intmap_length(map) == hashmap_length(ref));
+        }
+        intmap_iterator_t iter = intmap_iterator(map);
+        int *key, *value;
+        size_t n = 0;
+        while (intmap_it_next(&iter, &key, &value)) {
+                int *w = hashmap_get_ref(ref, key);
+                assert(w && *w == *value);
+                n++;
+        }
+        assert(n == hashmap_length(ref));
+        intmap_free(map);
+        hashmap_free(ref);
+        test_ok();
+}
+
+void collision_test(void){
+        test_step("Collisions");
+        pointmap_t *map = pointmap_init();
+        assert(pointmap_reserve(map, 2000) == GDS_SUCCESS);
+        size_t capacity = map->capacity;
+        for (int i = 0; i < 2000; i++)
+                assert(pointmap_put(map, (struct point){i, -i}, i * 0.5) == GDS_SUCCESS);
+        assert(map->capacity == capacity);
+        for (int i = 0; i < 2000; i++) {
+                double *v = pointmap_get_ref(map, (struct point){i, -i});
+                assert(v && *v == i * 0.5);
+                assert(!pointmap_exists(map, (struct point){i, i + 1}));
+        }
+        pointmap_free(map);
+        test_ok();
+}
+
+int main(void){
+        test_start("typed_hash_map.h");
+
+        test_simple();
+        random_test();
+        collision_test();
+
+        test_end("typed_hash_map.h");
+        return 0;
+}
@@ -0,0 +1,85 @@
+#include "../include/typed_heap.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GDS_DEFINE_HEAP(intheap, int, a < b)
+
+struct task { int priority; int id; };
+/* Max-heap, by priority */
+GDS_DEFINE_HEAP(taskheap, struct task, a.priority > b.priority)
+
+void test_simple(void){
+        intheap_t *heap = intheap_init();
+        assert(heap && intheap_isempty(heap));
+        int values[] = { 5, 3, 8, 1, 9, 2, 7 };
+        for (int i = 0; i < 7; i++)
+                assert(intheap_add(heap, values[i]) == GDS_SUCCESS);
+        int min;
+        assert(intheap_peek(heap, &min) && min == 1);
+        for (int expected = 1, i = 0; i < 7; i++) {
+                assert(intheap_pop_min(heap, &min));
+                assert(min >= expected);
+                expected = min;
+        }
+        assert(intheap_isempty(heap) && !intheap_pop_min(heap, &min));
+        intheap_free(heap);
+}
+
+static int cmp_int(const void *a, const void *b){
+        return *(int*) a - *(int*) b;
+}
+
+void heapsort_test(void){
+        test_step("Heap sort");
+        const int n = 100000;
+        int *values = malloc(n * sizeof(int));
+        int *sorted = malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++)
+                values[i] = rand() % 1000;
+        memcpy(sorted, values, n * sizeof(int));
+        qsort(sorted, n, sizeof(int), cmp_int);
+
+        intheap_t *heap = intheap_init();
+        /* Bulk (heapify), then element by element */
+        assert(intheap_add_array(heap, values, n / 2) == GDS_SUCCESS);
+        assert(intheap_add_array(heap, values + n / 2, 10) == GDS_SUCCESS);
+        for (int i = n / 2 + 10; i < n; i++)
+                assert(intheap_add(heap, values[i]) == GDS_SUCCESS);
+        assert(intheap_size(heap) == (size_t) n);
+        for (int i = 0; i < n; i++) {
+                int min;
+                assert(intheap_pop_min(heap, &min) && min == sorted[i]);
+        }
+        intheap_free(heap);
+        free(values);
+        free(sorted);
+        test_ok();
+}
+
+void struct_test(void){
+        test_step("Struct");
+        taskheap_t *heap = taskheap_init();
+        for (int i = 0; i < 1000; i++)
+                taskheap_add(heap, (struct task){ (i * 37) % 101, i });
+        struct task t;
+        int last = 1000;
+        while (taskheap_pop_min(heap, &t)) {
+                assert(t.priority <= last);
+                last = t.priority;
+        }
+        taskheap_free(heap);
+        test_ok();
+}
+
+int main(void){
+        test_start("typed_heap.h");
+
+        test_simple();
+        heapsort_test();
+        struct_test();
+
+        test_end("typed_heap.h");
+        return 0;
+}
@@ -0,0 +1,91 @@
+#include "../include/typed_vector.h"
+#include "../include/vector.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GDS_DEFINE_VECTOR(intvec, int)
+
+struct point { double x, y; };
+GDS_DEFINE_VECTOR(pointvec, struct point)
+
+void test_simple(void){
+        intvec_t *v = intvec_init();
+        assert(v && intvec_isempty(v));
+        for (int i = 0; i < 100; i++)
+                assert(intvec_append(v, i) == GDS_SUCCESS);
+        assert(intvec_size(v) == 100);
+        int x;
+        assert(intvec_at(v, 10, &x) && x == 10);
+        assert(intvec_at(v, -1, &x) && x == 99);
+        assert(!intvec_at(v, 100, &x));
+        assert(!intvec_at_ref(v, -101));
+        assert(intvec_set_at(v, 0, -5) == GDS_SUCCESS && *intvec_front_ref(v) == -5);
+        assert(intvec_set_at(v, 100, 0) == GDS_INDEX_BOUNDS_ERROR);
+
+        assert(intvec_push_front(v, 1000) == GDS_SUCCESS);
+        assert(intvec_insert_at(v, 50, 2000) == GDS_SUCCESS);
+        assert(intvec_front(v, &x) && x == 1000);
+        assert(*intvec_at_ref(v, 50) == 2000 && *intvec_at_ref(v, 51) == 49);
+        assert(intvec_remove_at(v, 50) == GDS_SUCCESS);
+        assert(intvec_pop_front(v, &x) && x == 1000);
+        assert(intvec_pop_back(v, &x) && x == 99);
+        assert(intvec_back(v, &x) && x == 98);
+        assert(intvec_swap(v, 0, -1) == GDS_SUCCESS && *intvec_front_ref(v) == 98);
+        assert(intvec_size(v) == 99);
+
+        int array[] = { 1, 2, 3 };
+        assert(intvec_append_array(v, array, 3) == GDS_SUCCESS);
+        assert(*intvec_back_ref(v) == 3 && intvec_size(v) == 102);
+        intvec_pop_back(v, NULL);
+        assert(*intvec_back_ref(v) == 2 && intvec_size(v) == 101);
+        assert(intvec_shrink(v) == GDS_SUCCESS && intvec_capacity(v) == 101);
+        intvec_clear(v);
+        assert(intvec_isempty(v) && !intvec_pop_back(v, &x));
+        intvec_free(v);
+}
+
+/* Random operations, checked against a vector_t */
+void random_test(void){
+        test_step("Random");
+        pointvec_t *v = pointvec_with_capacity(0);
+        vector_t *ref = vector_init(sizeof(struct point), compare_equal);
+        for (int it = 0; it < 20000; it++) {
+                struct point p = { it, -it }, q, r;
+                ptrdiff_t index = vector_size(ref) ? rand() % (ptrdiff_t) vector_size(ref) : 0;
+                switch (rand() % 5) {
+                case 0:
+                        assert(pointvec_append(v, p) == GDS_SUCCESS);
+                        vector_append(ref, &p);
+                        break;
+                case 1:
+                        assert(pointvec_insert_at(v, index, p) == GDS_SUCCESS);
+                        vector_insert_at(ref, index, &p);
+                        break;
+                case 2:
+                        assert((pointvec_pop_at(v, index, &q) == NULL) == (vector_pop_at(ref, index, &r) == NULL));
+                        break;
+                case 3:
+                        assert((pointvec_pop_back(v, &q) == NULL) == (vector_pop_back(ref, &r) == NULL));
+                        break;
+                default:
+                        assert(pointvec_reserve(v, it) == GDS_SUCCESS);
+                }
+                assert(pointvec_size(v) == vector_size(ref));
+        }
+        assert(memcmp(pointvec_get_buffer(v), vector_get_buffer(ref), vector_size(ref) * sizeof(struct point)) == 0);
+        pointvec_free(v);
+        vector_free(ref);
+        test_ok();
+}
+
+int main(void){
+        test_start("typed_vector.h");
+
+        test_simple();
+        random_test();
+
+        test_end("typed_vector.h");
+        return 0;
+}